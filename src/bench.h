@@ -0,0 +1,123 @@
+#ifndef bench_h
+#define bench_h
+
+#include <chrono>
+#include <vector>
+#include "scene.h"
+#include "camera.h"
+#include "tracer.h"
+
+// Traversal micro benchmarks, single threaded.
+// Rays are camera rays and one diffuse bounce from their hits, generated before timing.
+// And full renders with each integrator.
+
+// results are stored here so the timed loops are not optimized away
+inline volatile int bench_sink = 0;
+
+inline std::vector<Ray> bench_make_rays(const Scene& scene, Camera& camera, int ray_count) {
+    std::vector<Ray> rays;
+    rays.reserve(ray_count);
+    Rng rng(1);
+    Sampler sampler(SamplerType_Independent, 1, rng);
+    for (int k = 0; k < ray_count; k++) {
+        Vec3 viewport_point;
+        Ray ray = camera.make_ray(int(rng.uniform() * camera.screen_W), int(rng.uniform() * camera.screen_H), viewport_point, sampler);
+        Hit hit;
+        if ((k & 1) && scene.hit(ray, Interval(camera.ray_hit_min, camera.ray_hit_max), hit)) {
+            ray = Ray(hit.p, norm(hit.n + random_unit_vector(rng)), ray.time());
+        }
+        rays.push_back(ray);
+    }
+    return rays;
+}
+
+// ns per closest hit query through Scene::hit
+inline double bench_scene_hit(const Scene& scene, const std::vector<Ray>& rays, const Interval& limits) {
+    int hits = 0;
+    auto t0 = std::chrono::high_resolution_clock::now();
+    for (const Ray& ray: rays) {
+        Hit hit;
+        hits += scene.hit(ray, limits, hit);
+    }
+    auto t1 = std::chrono::high_resolution_clock::now();
+    bench_sink = hits;
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / rays.size();
+}
+
+// ns per any hit query through Scene::occluded
+inline double bench_scene_occluded(const Scene& scene, const std::vector<Ray>& rays, const Interval& limits) {
+    int hits = 0;
+    auto t0 = std::chrono::high_resolution_clock::now();
+    for (const Ray& ray: rays) {
+        hits += scene.occluded(ray, limits);
+    }
+    auto t1 = std::chrono::high_resolution_clock::now();
+    bench_sink = hits;
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / rays.size();
+}
+
+// ns per ray-box test: every node of the scene's binary BVH against every ray
+inline double bench_box_tests(const Scene& scene, const std::vector<Ray>& rays, const Interval& limits) {
+    const std::vector<LinearBVHNode>& nodes = scene.bvh->binary_tree().nodes;
+    if (nodes.empty()) return 0;
+    int hits = 0;
+    auto t0 = std::chrono::high_resolution_clock::now();
+    for (const Ray& ray: rays) {
+        for (const LinearBVHNode& node: nodes) {
+            hits += BVHTree::box_hit(node, ray, limits);
+        }
+    }
+    auto t1 = std::chrono::high_resolution_clock::now();
+    bench_sink = hits;
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / ((double) rays.size() * nodes.size());
+}
+
+inline void bench_traversal(const Scene& scene, Camera& camera, const char* name) {
+    Interval limits(camera.ray_hit_min, camera.ray_hit_max);
+    std::vector<Ray> rays = bench_make_rays(scene, camera, 100000);
+    double ns_ray = bench_scene_hit(scene, rays, limits);
+    double ns_occluded = bench_scene_occluded(scene, rays, limits);
+    rays.resize(10000);
+    double ns_node = bench_box_tests(scene, rays, limits);
+    std::cout << name << ": scene hit: " << ns_ray << " ns/ray, occluded: " << ns_occluded << " ns/ray, box test: " << ns_node << " ns/node" << std::endl;
+}
+
+// Renders the scene with the megakernel and the wavefront integrator at samples_per_pixel on the pool,
+// the best of repeats each, alternating. Prints the times and checks the images are the same.
+inline void bench_integrators(const Scene& scene, Camera& camera, Tracer& tracer, WorkStealingPool& pool,
+                              const char* name, int samples_per_pixel, int repeats = 3) {
+    const int scene_samples = camera.samples_per_pixel;
+    const IntegratorType scene_integrator = tracer.integrator;
+    camera.samples_per_pixel = samples_per_pixel;
+    camera.samples_per_pixel_inv = 1 / (double) samples_per_pixel;
+    
+    const IntegratorType integrators[2] = { IntegratorType_Megakernel, IntegratorType_Wavefront };
+    double best_ms[2] = { infinity, infinity };
+    std::vector<Vec3> images[2];
+    for (int r = 0; r < repeats; r++) {
+        for (int k = 0; k < 2; k++) {
+            tracer.integrator = integrators[k];
+            auto t0 = std::chrono::high_resolution_clock::now();
+            tracer.render(scene, camera, pool, nullptr, nullptr);
+            auto t1 = std::chrono::high_resolution_clock::now();
+            best_ms[k] = std::min(best_ms[k], std::chrono::duration<double, std::milli>(t1 - t0).count());
+            const Image& image = *camera.image;
+            images[k].assign(image.Pixels(), image.Pixels() + image.W() * image.H());
+        }
+    }
+    bool same = true;
+    for (size_t i = 0; i < images[0].size(); i++) {
+        for (int c = 0; c < 3; c++) {
+            same &= images[0][i][c] == images[1][i][c];
+        }
+    }
+    
+    camera.samples_per_pixel = scene_samples;
+    camera.samples_per_pixel_inv = 1 / (double) scene_samples;
+    tracer.integrator = scene_integrator;
+    std::cout << name << ": " << samples_per_pixel << " spp, megakernel: " << best_ms[0] << "ms, wavefront: "
+              << best_ms[1] << "ms (" << best_ms[0] / best_ms[1] << "x), images "
+              << (same ? "identical" : "differ") << std::endl;
+}
+
+#endif /* bench_h */
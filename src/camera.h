@@ -2,6 +2,7 @@
 #define camera_h
 
 #include "ray.h"
+#include "sampler.h"
 
 #define PRINT_PROGRESS 0
 
@@ -19,10 +20,29 @@ public:
     double ray_hit_min = 0.001;
     double ray_hit_max = infinity;
     int max_bounces = 10;
+    // Russian roulette from this bounce on, above max_bounces turns it off.
+    // Paths whose throughput is below roulette_threshold continue with probability throughput / threshold.
+    int roulette_min_bounces = 3;
+    double roulette_threshold = 0.1;
+    // Next event estimation: diffuse hits also sample the scene's lights with a shadow ray,
+    // combined with the bounce that hits a light by multiple importance sampling
+    bool sample_lights = true;
     
     // multi-sampling
     int samples_per_pixel = 10;
     double samples_per_pixel_inv;
+    // Index of the first sample, the render takes samples [first_sample, first_sample + samples_per_pixel).
+    // Random numbers are keyed by the sample index, so renders of disjoint ranges can be averaged.
+    int first_sample = 0;
+    // Stratified and CMJ patterns are made for first_sample + samples_per_pixel samples,
+    // Sobol doesn't depend on the count, split ranges of a render should use it
+    SamplerType sampler_type = SamplerType_Sobol;
+    
+    // Adaptive sampling: a pixel stops once one standard error of its mean is below noise_target
+    // in display units (1/255 is one 8 bit step), samples_per_pixel is then the cap.
+    // Pixels take at least adaptive_min_samples. 0 renders every pixel with samples_per_pixel samples.
+    double noise_target = 0;
+    int adaptive_min_samples = 16;
     
     Vec3 background = Vec3::zero();
     
@@ -114,10 +134,10 @@ public:
     }
     
     // A ray with random direction offset within a pixel square
-    Ray make_ray(int x, int y, Vec3& viewport_point) {
+    Ray make_ray(int x, int y, Vec3& viewport_point, Sampler& sampler) {
         
         // point on the image plane
-        Vec3 offset_aa = sample_unit_square();
+        Vec3 offset_aa = sample_unit_square(sampler);
         Vec3 point = p00;
         point +=  camera_right * (x * point_delta.X() + point_delta.X() * offset_aa.X());
         point += -camera_up    * (y * point_delta.Y() + point_delta.Y() * offset_aa.Y());
@@ -125,12 +145,12 @@ public:
         // ray origin
         Vec3 origin = camera_pos;
         if (defocus_angle > 0) {
-            Vec3 offset_defocus = defocus_radius * sample_unit_disk();
+            Vec3 offset_defocus = defocus_radius * sample_unit_disk(sampler);
             origin += camera_right * offset_defocus.X();
             origin += camera_up    * offset_defocus.Y();
         }
         // origin = point; // visualize the focus plane
-        double time = rw_random();
+        double time = sampler.get_1d();
         viewport_point = point;
         Ray ray = Ray(origin, norm(point - origin), time);
         return ray;
@@ -138,14 +158,18 @@ public:
     
     // A random offset to apply to a pixel ray for AA.
     // Random point within unit square between [-0.5, -0.5] and [0.5, 0.5]
-    Vec3 sample_unit_square() {
-        return Vec3(rw_random() - 0.5, rw_random() - 0.5, 0);
+    Vec3 sample_unit_square(Sampler& sampler) {
+        double x, y;
+        sampler.get_2d(x, y);
+        return Vec3(x - 0.5, y - 0.5, 0);
     }
     
-    Vec3 sample_unit_disk () {
+    Vec3 sample_unit_disk (Sampler& sampler) {
         // This approach shifts probability towards the disk edge,
         // because it samples the square - more points outside of disk
-        Vec3 v = Vec3(rw_random(-1, 1), rw_random(-1, 1), 0);
+        double x, y;
+        sampler.get_2d(x, y);
+        Vec3 v = Vec3(2 * x - 1, 2 * y - 1, 0);
         if (v.len() > 1) {
             v = norm(v);
         }
@@ -52,24 +52,23 @@ public:
         return zi;
     }
     
+    // Slab test with the ray's precomputed inverse direction, no swaps or divisions
     bool hit(const Ray& ray, Interval ray_dt) const {
-        const Vec3& ro = ray.origin();
-        const Vec3& rd = ray.dir();
+        const Vec3& r_inv = ray.dir_inv();
+        const Vec3& ro_inv = ray.origin_inv();
         
         for (int axis=0; axis<3; axis++) {
             const Interval& interval = axis_interval(axis);
-            const double r_axis_inv = 1.0 / rd[axis];
+            const int sign = ray.sign(axis);
             
-            double t0 = ( interval.min - ro[axis] ) * r_axis_inv;
-            double t1 = ( interval.max - ro[axis] ) * r_axis_inv;
+            double t0 = interval.bound(sign)     * r_inv[axis] - ro_inv[axis];
+            double t1 = interval.bound(1 - sign) * r_inv[axis] - ro_inv[axis];
             
-            if (t0 > t1) std::swap(t0, t1);
+            // comparisons are false for NaN (ray on a slab plane), the limits are kept then
             if (t0 > ray_dt.min) ray_dt.min = t0;
             if (t1 < ray_dt.max) ray_dt.max = t1;
-            
-            if (ray_dt.max <= ray_dt.min) return false;
         }
-        return true;
+        return ray_dt.min < ray_dt.max;
     }
     
     int longest_axis() const {
@@ -13,6 +13,7 @@ public:
     AABB bbox;
     std::shared_ptr<Hittable> left;
     std::shared_ptr<Hittable> right;
+    int axis = 0; // left holds the lower boxes along this axis
     
     BVH_Node() : Hittable(HittableType_BVH_Node) {}
     
@@ -29,7 +30,7 @@ public:
         for (size_t i=start; i < end; i++)
             bbox = AABB(bbox, objects[i]->bounding_box());
 
-        int axis = bbox.longest_axis(); // 50ms speedup for the bouncing spheres sccene (470ms -> 420ms)
+        axis = bbox.longest_axis(); // 50ms speedup for the bouncing spheres sccene (470ms -> 420ms)
         
         auto comparator = (axis == 0) ? box_x_compare
                           : (axis == 1) ? box_y_compare
@@ -58,13 +59,24 @@ public:
     bool hit(const Ray& ray, const Interval& interval, Hit& hit) const {
         if ( !bbox.hit(ray, interval) )
             return false;
-        bool in_left = left->hit(ray, interval, hit);
-        bool in_right = right->hit(ray, Interval(interval.min, in_left ? hit.d : interval.max), hit);
-        return in_left || in_right;
+        // near child first, its hit shrinks the interval the far child is tested with
+        Hittable* first = left.get();
+        Hittable* second = right.get();
+        if (ray.sign(axis))
+            std::swap(first, second);
+        bool in_first = first->hit(ray, interval, hit);
+        bool in_second = second->hit(ray, Interval(interval.min, in_first ? hit.d : interval.max), hit);
+        return in_first || in_second;
     }
     
-    static bool box_compare(const std::shared_ptr<Hittable> a,
-                            const std::shared_ptr<Hittable> b,
+    bool occluded(const Ray& ray, const Interval& interval) const {
+        if ( !bbox.hit(ray, interval) )
+            return false;
+        return left->occluded(ray, interval) || right->occluded(ray, interval);
+    }
+    
+    static bool box_compare(const std::shared_ptr<Hittable>& a,
+                            const std::shared_ptr<Hittable>& b,
                             int axis_index )
     {
         auto a_axis_interval = a->bounding_box().axis_interval(axis_index);
@@ -72,18 +84,18 @@ public:
         return a_axis_interval.min < b_axis_interval.min;
     }
     
-    static bool box_x_compare (const std::shared_ptr<Hittable> a,
-                               const std::shared_ptr<Hittable> b) {
+    static bool box_x_compare (const std::shared_ptr<Hittable>& a,
+                               const std::shared_ptr<Hittable>& b) {
         return box_compare(a, b, 0);
     }
     
-    static bool box_y_compare (const std::shared_ptr<Hittable> a,
-                               const std::shared_ptr<Hittable> b) {
+    static bool box_y_compare (const std::shared_ptr<Hittable>& a,
+                               const std::shared_ptr<Hittable>& b) {
         return box_compare(a, b, 1);
     }
     
-    static bool box_z_compare (const std::shared_ptr<Hittable> a,
-                               const std::shared_ptr<Hittable> b) {
+    static bool box_z_compare (const std::shared_ptr<Hittable>& a,
+                               const std::shared_ptr<Hittable>& b) {
         return box_compare(a, b, 2);
     }
 };
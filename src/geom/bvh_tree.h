@@ -0,0 +1,501 @@
+#ifndef bvh_tree_h
+#define bvh_tree_h
+
+#include <vector>
+#include <memory>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "aabb.h"
+#include "hittable.h"
+#include "../util/work_stealing_pool.h"
+
+// Flattened Bounding Volume Hierarchy
+// Nodes live in one contiguous array in depth first order: the first child of an interior node
+// is the next node in the array, the second child is at `offset`.
+// Leaves reference a contiguous range of primitives, primitives are reordered to match.
+
+
+// 32 bytes, two nodes per cache line
+struct LinearBVHNode {
+    float bounds[2][3]; // min, max
+    uint32_t offset; // leaf: first primitive, interior: second child
+    uint16_t count;  // primitives in a leaf, 0 for interior nodes
+    uint8_t axis;    // split axis of interior nodes
+    uint8_t pad;
+
+    bool is_leaf() const { return count > 0; }
+};
+
+static_assert(sizeof(LinearBVHNode) == 32, "LinearBVHNode should stay 32 bytes");
+
+
+// Build input: bounds and centroid of one primitive, index into the caller's primitive array
+struct BVHPrimitive {
+    AABB bbox;
+    Vec3 centroid;
+    uint32_t index;
+
+    BVHPrimitive() { }
+    BVHPrimitive(const AABB& bbox, uint32_t index) : bbox(bbox), index(index) {
+        centroid = Vec3(bbox.xi.min + bbox.xi.size() * 0.5,
+                        bbox.yi.min + bbox.yi.size() * 0.5,
+                        bbox.zi.min + bbox.zi.size() * 0.5);
+    }
+};
+
+
+// Min/max accumulation for the build loops, without AABB's minimum size padding.
+// Trivial type, start from BVHBounds::empty().
+struct BVHBounds {
+    double min[3];
+    double max[3];
+
+    static BVHBounds empty() {
+        return { { infinity, infinity, infinity }, { -infinity, -infinity, -infinity } };
+    }
+
+    void grow(const AABB& box) {
+        for (int a = 0; a < 3; a++) {
+            const Interval& interval = box.axis_interval(a);
+            min[a] = std::min(min[a], interval.min);
+            max[a] = std::max(max[a], interval.max);
+        }
+    }
+
+    void grow(const Vec3& p) {
+        for (int a = 0; a < 3; a++) {
+            min[a] = std::min(min[a], p[a]);
+            max[a] = std::max(max[a], p[a]);
+        }
+    }
+
+    void grow(const BVHBounds& b) {
+        for (int a = 0; a < 3; a++) {
+            min[a] = std::min(min[a], b.min[a]);
+            max[a] = std::max(max[a], b.max[a]);
+        }
+    }
+
+    double size(int axis) const {
+        return max[axis] - min[axis];
+    }
+
+    double area() const {
+        double dx = size(0), dy = size(1), dz = size(2);
+        return 2 * (dx*dy + dy*dz + dz*dx);
+    }
+
+    int longest_axis() const {
+        if (size(0) > size(1))
+            return size(0) > size(2) ? 0 : 2;
+        return size(1) > size(2) ? 1 : 2;
+    }
+
+    AABB aabb() const {
+        return AABB(Interval(min[0], max[0]), Interval(min[1], max[1]), Interval(min[2], max[2]));
+    }
+};
+
+
+enum class BVHSplitMethod {
+    middle, // middle primitive along the longest centroid axis
+    sah,    // binned surface area heuristic
+};
+
+struct BVHBuildOptions {
+    BVHSplitMethod split_method = BVHSplitMethod::sah;
+    int sah_bins = 12; // at most 32
+    double traversal_cost = 1.0; // visiting an interior node
+    double leaf_cost = 1.0;      // intersecting one primitive in a leaf
+    int max_leaf_size = 4;
+    
+    // Primitives a leaf intersects in one go (LinearBVH packs spheres and quads in SIMD batches),
+    // the SAH prices a leaf per started batch
+    int leaf_batch_width = 1;
+    bool batch_leaves = true; // LinearBVH sets leaf_batch_width when most primitives batch
+    
+    // Traverse a WideBVHTree collapsed from the binary tree, with SIMD box tests,
+    // for trees of at least wide_min_size primitives. A few primitives are faster in the binary tree.
+    bool wide = true;
+    int wide_min_size = 16;
+    
+    // Builds subtrees with at least parallel_min_size primitives as pool tasks.
+    // The build waits on the pool, don't build from a worker thread with a pool set.
+    WorkStealingPool* pool = nullptr;
+    int parallel_min_size = 4096;
+    
+    bool use_wide(size_t primitive_count) const {
+        return wide && primitive_count >= (size_t) wide_min_size;
+    }
+};
+
+
+// Pointer based tree, only used during the build, flattened afterwards
+struct BVHBuildNode {
+    AABB bbox;
+    std::unique_ptr<BVHBuildNode> children[2];
+    uint32_t first = 0; // first primitive of a leaf
+    uint32_t count = 0; // 0 for interior nodes
+    int axis = 0;
+};
+
+
+// Node array and primitive order, independent of the primitive type
+class BVHTree {
+public:
+    std::vector<LinearBVHNode> nodes;
+    std::vector<uint32_t> indices; // primitive index for each leaf slot
+    AABB bbox;
+
+    BVHBuildOptions options;
+
+    void build(std::vector<BVHPrimitive>& prims, const BVHBuildOptions& options) {
+        this->options = options;
+        nodes.clear();
+        indices.clear();
+        bbox = AABB::empty;
+        if (prims.empty()) return;
+
+        std::atomic_int node_count = 0;
+        std::unique_ptr<BVHBuildNode> root;
+        build_recursive(prims, 0, (uint32_t) prims.size(), root, node_count);
+        if (options.pool) {
+            options.pool->wait(); // subtrees built as tasks
+        }
+        bbox = root->bbox;
+
+        indices.resize(prims.size());
+        for (size_t i = 0; i < prims.size(); i++) {
+            indices[i] = prims[i].index;
+        }
+
+        nodes.reserve(node_count);
+        flatten(root.get());
+    }
+
+    // leaf_hit(first_slot, count, ray, limits, hit) tests the primitives of one leaf, slots are positions in `indices`.
+    // Returns true when one of them is hit within limits, with the closest in `hit`.
+    template<class LeafHit>
+    bool traverse(const Ray& ray, Interval limits, Hit& hit, LeafHit&& leaf_hit) const {
+        if (nodes.empty()) return false;
+
+        bool hit_anything = false;
+        uint32_t stack[64];
+        int stack_size = 0;
+        uint32_t node_index = 0;
+
+        while (true) {
+            const LinearBVHNode& node = nodes[node_index];
+            if (box_hit(node, ray, limits)) {
+                if (node.is_leaf()) {
+                    if (leaf_hit(node.offset, node.count, ray, limits, hit)) {
+                        hit_anything = true;
+                        limits.max = hit.d;
+                    }
+                    if (stack_size == 0) break;
+                    node_index = stack[--stack_size];
+                }
+                else if (ray.sign(node.axis)) {
+                    // ray points down the split axis, the second child is nearer
+                    stack[stack_size++] = node_index + 1;
+                    node_index = node.offset;
+                }
+                else {
+                    stack[stack_size++] = node.offset;
+                    node_index = node_index + 1;
+                }
+            }
+            else {
+                if (stack_size == 0) break;
+                node_index = stack[--stack_size];
+            }
+        }
+        return hit_anything;
+    }
+
+    // Any hit query, leaf_occluded(first_slot, count, ray, limits) tests the primitives of one leaf.
+    // Returns on the first primitive that blocks the ray, the limits never shrink.
+    template<class LeafOccluded>
+    bool occluded(const Ray& ray, const Interval& limits, LeafOccluded&& leaf_occluded) const {
+        if (nodes.empty()) return false;
+
+        uint32_t stack[64];
+        int stack_size = 0;
+        uint32_t node_index = 0;
+
+        while (true) {
+            const LinearBVHNode& node = nodes[node_index];
+            if (box_hit(node, ray, limits)) {
+                if (node.is_leaf()) {
+                    if (leaf_occluded(node.offset, node.count, ray, limits)) return true;
+                    if (stack_size == 0) break;
+                    node_index = stack[--stack_size];
+                }
+                else {
+                    stack[stack_size++] = node.offset;
+                    node_index = node_index + 1;
+                }
+            }
+            else {
+                if (stack_size == 0) break;
+                node_index = stack[--stack_size];
+            }
+        }
+        return false;
+    }
+
+    // Expected cost of a random ray query, relative to the root surface area.
+    // Lower is better, used to compare builders.
+    double sah_cost() const {
+        if (nodes.empty()) return 0;
+        double root_area = surface_area(nodes[0]);
+        double cost = 0;
+        for (const LinearBVHNode& node: nodes) {
+            double p = surface_area(node) / root_area;
+            cost += node.is_leaf() ? p * leaf_batches(node.count) * options.leaf_cost : p * options.traversal_cost;
+        }
+        return cost;
+    }
+
+    double leaf_batches(uint32_t count) const {
+        const uint32_t width = (uint32_t) std::max(options.leaf_batch_width, 1);
+        return (double) ((count + width - 1) / width);
+    }
+
+    static double surface_area(const LinearBVHNode& node) {
+        double dx = node.bounds[1][0] - node.bounds[0][0];
+        double dy = node.bounds[1][1] - node.bounds[0][1];
+        double dz = node.bounds[1][2] - node.bounds[0][2];
+        return 2 * (dx*dy + dy*dz + dz*dx);
+    }
+
+    static double surface_area(const AABB& box) {
+        double dx = box.xi.size();
+        double dy = box.yi.size();
+        double dz = box.zi.size();
+        return 2 * (dx*dy + dy*dz + dz*dx);
+    }
+
+    // Same slab test as AABB::hit
+    static bool box_hit(const LinearBVHNode& node, const Ray& ray, Interval ray_dt) {
+        const Vec3& r_inv = ray.dir_inv();
+        const Vec3& ro_inv = ray.origin_inv();
+
+        for (int axis=0; axis<3; axis++) {
+            const int sign = ray.sign(axis);
+
+            double t0 = node.bounds[sign][axis]     * r_inv[axis] - ro_inv[axis];
+            double t1 = node.bounds[1 - sign][axis] * r_inv[axis] - ro_inv[axis];
+
+            if (t0 > ray_dt.min) ray_dt.min = t0;
+            if (t1 < ray_dt.max) ray_dt.max = t1;
+        }
+        return ray_dt.min < ray_dt.max;
+    }
+
+private:
+
+    // Writes the subtree into `slot`. With a pool, large subtrees are finished later by pool tasks.
+    void build_recursive(std::vector<BVHPrimitive>& prims, uint32_t start, uint32_t end,
+                         std::unique_ptr<BVHBuildNode>& slot, std::atomic_int& node_count)
+    {
+        slot = std::make_unique<BVHBuildNode>();
+        BVHBuildNode* node = slot.get();
+        node_count++;
+
+        BVHBounds bbox = BVHBounds::empty();
+        BVHBounds centroid_bbox = BVHBounds::empty();
+        for (uint32_t i = start; i < end; i++) {
+            bbox.grow(prims[i].bbox);
+            centroid_bbox.grow(prims[i].centroid);
+        }
+        node->bbox = bbox.aabb();
+
+        uint32_t count = end - start;
+        if ((int) count <= 1) {
+            node->first = start;
+            node->count = count;
+            return;
+        }
+
+        int axis = centroid_bbox.longest_axis();
+        uint32_t mid = start;
+        bool make_leaf = false;
+
+        if (options.split_method == BVHSplitMethod::sah) {
+            mid = split_sah(prims, start, end, bbox, centroid_bbox, axis, make_leaf);
+        }
+        else {
+            make_leaf = (int) count <= options.max_leaf_size;
+        }
+
+        if (make_leaf) {
+            node->first = start;
+            node->count = count;
+            return;
+        }
+
+        if (mid == start || mid == end) {
+            mid = split_middle(prims, start, end, axis);
+        }
+
+        node->axis = axis;
+        
+        // children work on disjoint primitive ranges
+        if (options.pool && (int) count >= options.parallel_min_size) {
+            options.pool->enqueue([this, &prims, node, start, mid, &node_count] {
+                this->build_recursive(prims, start, mid, node->children[0], node_count);
+            });
+        }
+        else {
+            build_recursive(prims, start, mid, node->children[0], node_count);
+        }
+        build_recursive(prims, mid, end, node->children[1], node_count);
+    }
+
+    // Splits at the middle primitive along the given axis
+    uint32_t split_middle(std::vector<BVHPrimitive>& prims, uint32_t start, uint32_t end, int axis) {
+        uint32_t mid = start + (end - start) / 2;
+        std::nth_element(prims.begin() + start, prims.begin() + mid, prims.begin() + end,
+                         [axis](const BVHPrimitive& a, const BVHPrimitive& b) {
+            return a.centroid[axis] < b.centroid[axis];
+        });
+        return mid;
+    }
+
+    // Bins the centroids on every axis in one pass and picks the cheapest bin boundary.
+    // Sets make_leaf when a leaf costs less than any split, returns the partition point otherwise.
+    uint32_t split_sah(std::vector<BVHPrimitive>& prims, uint32_t start, uint32_t end,
+                       const BVHBounds& bbox, const BVHBounds& centroid_bbox, int& axis, bool& make_leaf)
+    {
+        struct Bin {
+            BVHBounds bounds;
+            uint32_t count;
+        };
+        constexpr int max_bins = 32;
+
+        const uint32_t count = end - start;
+        const int bin_count = std::clamp(options.sah_bins, 2, max_bins);
+        const double node_area = bbox.area();
+
+        // centroid to bin: (c - min) * scale, axes without extent are skipped
+        double scale[3];
+        bool binned[3];
+        for (int a = 0; a < 3; a++) {
+            binned[a] = centroid_bbox.size(a) > 0;
+            scale[a] = binned[a] ? bin_count / centroid_bbox.size(a) : 0;
+        }
+
+        Bin bins[3][max_bins]; // only bin_count are used and reset
+        for (int a = 0; a < 3; a++) {
+            for (int b = 0; b < bin_count; b++) {
+                bins[a][b] = { BVHBounds::empty(), 0 };
+            }
+        }
+        for (uint32_t i = start; i < end; i++) {
+            const BVHPrimitive& prim = prims[i];
+            for (int a = 0; a < 3; a++) {
+                Bin& bin = bins[a][bin_index(prim, a, centroid_bbox.min[a], scale[a], bin_count)];
+                bin.bounds.grow(prim.bbox);
+                bin.count++;
+            }
+        }
+
+        double best_cost = infinity;
+        int best_axis = -1;
+        int best_split = 0; // bins [0, best_split) go left
+
+        for (int a = 0; a < 3; a++) {
+            if (!binned[a]) continue;
+
+            // sweep from the right, then from the left
+            double right_area[max_bins];
+            uint32_t right_count[max_bins];
+            BVHBounds box = BVHBounds::empty();
+            uint32_t n = 0;
+            for (int b = bin_count - 1; b > 0; b--) {
+                box.grow(bins[a][b].bounds);
+                n += bins[a][b].count;
+                right_area[b] = n > 0 ? box.area() : 0;
+                right_count[b] = n;
+            }
+
+            box = BVHBounds::empty();
+            n = 0;
+            for (int b = 1; b < bin_count; b++) {
+                box.grow(bins[a][b-1].bounds);
+                n += bins[a][b-1].count;
+                if (n == 0 || right_count[b] == 0) continue;
+                double cost = options.traversal_cost
+                            + options.leaf_cost * (box.area() * leaf_batches(n) + right_area[b] * leaf_batches(right_count[b])) / node_area;
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = a;
+                    best_split = b;
+                }
+            }
+        }
+
+        double leaf_cost = options.leaf_cost * leaf_batches(count);
+        if ((int) count <= options.max_leaf_size && (best_axis < 0 || leaf_cost <= best_cost)) {
+            make_leaf = true;
+            return start;
+        }
+        if (best_axis < 0) {
+            // all centroids in one point, no bin boundary separates them,
+            // returning start falls back to the middle split
+            return start;
+        }
+
+        axis = best_axis;
+        const double axis_min = centroid_bbox.min[axis];
+        const double axis_scale = scale[axis];
+        auto it = std::partition(prims.begin() + start, prims.begin() + end,
+                                 [&](const BVHPrimitive& prim) {
+            return bin_index(prim, best_axis, axis_min, axis_scale, bin_count) < best_split;
+        });
+        return (uint32_t) (it - prims.begin());
+    }
+
+    static int bin_index(const BVHPrimitive& prim, int axis, double min, double scale, int bin_count) {
+        int b = (int) ((prim.centroid[axis] - min) * scale);
+        return std::clamp(b, 0, bin_count - 1);
+    }
+
+    uint32_t flatten(const BVHBuildNode* build_node) {
+        uint32_t index = (uint32_t) nodes.size();
+        nodes.emplace_back();
+
+        LinearBVHNode node;
+        store_bounds(node, build_node->bbox);
+        node.axis = (uint8_t) build_node->axis;
+        node.pad = 0;
+        if (build_node->count > 0) {
+            node.offset = build_node->first;
+            node.count = (uint16_t) build_node->count;
+        }
+        else {
+            flatten(build_node->children[0].get());
+            node.offset = flatten(build_node->children[1].get());
+            node.count = 0;
+        }
+        nodes[index] = node;
+        return index;
+    }
+
+    // Rounds outward, so float bounds never cut off the double precision box
+    static void store_bounds(LinearBVHNode& node, const AABB& box) {
+        for (int axis = 0; axis < 3; axis++) {
+            const Interval& interval = box.axis_interval(axis);
+            float fmin = (float) interval.min;
+            float fmax = (float) interval.max;
+            if (fmin > interval.min) fmin = std::nextafter(fmin, -std::numeric_limits<float>::infinity());
+            if (fmax < interval.max) fmax = std::nextafter(fmax,  std::numeric_limits<float>::infinity());
+            node.bounds[0][axis] = fmin;
+            node.bounds[1][axis] = fmax;
+        }
+    }
+};
+
+#endif /* bvh_tree_h */
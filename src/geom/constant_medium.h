@@ -2,7 +2,7 @@
 #define constant_medium_h
 
 #include "hittable.h"
-#include "../material.h"
+#include "../material_table.h"
 #include "../img/texture.h"
 
 class ConstantMedium : public Hittable {
@@ -18,7 +18,44 @@ class ConstantMedium : public Hittable {
         phase_function(make_shared<IsotropicMaterial>(albedo))
     {}
 
+    // A copy of medium filling another boundary, for finalization: the original may be shared
+    ConstantMedium(const ConstantMedium& medium, shared_ptr<Hittable> boundary)
+      : ConstantMedium(medium) { this->boundary = boundary; }
+
     bool hit(const Ray& r, const Interval& limits, Hit& hit) const {
+        if (!scatter_distance(r, limits, hit.d))
+            return false;
+
+        hit.p = r.at(hit.d);
+
+        hit.n = Vec3(1,0,0);  // arbitrary
+        hit.is_front = true;  // also arbitrary
+        hit.material = phase_function.id;
+        hit.light = -1;
+        hit.u = hit.v = 0;
+
+        return true;
+    }
+
+    // The ray scatters inside the medium with the same probability as in hit
+    bool occluded(const Ray& r, const Interval& limits) const {
+        double d;
+        return scatter_distance(r, limits, d);
+    }
+
+    AABB bounding_box() const { return boundary->bounding_box(); }
+
+    void bind_material(MaterialTable& table) { phase_function.bind(table); }
+
+    const shared_ptr<Hittable>& get_boundary() const { return boundary; }
+
+  private:
+    shared_ptr<Hittable> boundary;
+    double neg_inv_density;
+    MaterialRef phase_function;
+
+    // Samples where the ray scatters inside the boundary, false when it passes through
+    bool scatter_distance(const Ray& r, const Interval& limits, double& d) const {
         Hit hit1, hit2;
 
         if (!boundary->hit(r, Interval::universe, hit1))
@@ -38,27 +75,14 @@ class ConstantMedium : public Hittable {
 
         auto ray_length = r.dir().len();
         auto distance_inside_boundary = (hit2.d - hit1.d) * ray_length;
-        auto hit_distance = neg_inv_density * std::log(rw_random());
+        auto hit_distance = neg_inv_density * std::log(thread_rng().uniform());
 
         if (hit_distance > distance_inside_boundary)
             return false;
 
-        hit.d = hit1.d + hit_distance / ray_length;
-        hit.p = r.at(hit.d);
-
-        hit.n = Vec3(1,0,0);  // arbitrary
-        hit.is_front = true;  // also arbitrary
-        hit.material = phase_function.get();
-
+        d = hit1.d + hit_distance / ray_length;
         return true;
     }
-
-    AABB bounding_box() const { return boundary->bounding_box(); }
-
-  private:
-    shared_ptr<Hittable> boundary;
-    double neg_inv_density;
-    shared_ptr<Material> phase_function;
 };
 
 
@@ -0,0 +1,178 @@
+#ifndef finalize_h
+#define finalize_h
+
+#include <memory>
+#include <vector>
+#include "hittable.h"
+#include "hittable_list.h"
+#include "constant_medium.h"
+#include "transform.h"
+#include "linear_bvh.h"
+#include "bvh.h"
+#include "sphere.h"
+#include "quad.h"
+#include "mesh.h"
+#include "instance.h"
+#include "../material_table.h"
+#include "../light_list.h"
+
+// Scene finalization, run once by Scene::make_bvh when the scene is complete.
+
+// Lists with more children than this get their own BVH when they can't be flattened
+const size_t finalize_list_bvh_min_size = 4;
+
+inline std::shared_ptr<Hittable> finalize_hittable(const std::shared_ptr<Hittable>& object,
+                                                   const BVHBuildOptions& options);
+
+// Appends the children of nested lists instead of the lists, the other objects are finalized
+inline void append_flattened(std::vector<std::shared_ptr<Hittable>>& out, const std::shared_ptr<Hittable>& object,
+                             const BVHBuildOptions& options) {
+    if (object->type == HittableType_List) {
+        for (const auto& child: std::static_pointer_cast<HittableList>(object)->objects) {
+            append_flattened(out, child, options);
+        }
+        return;
+    }
+    out.push_back(finalize_hittable(object, options));
+}
+
+// Replaces chains of Translate/RotateY/Transform wrappers with one Transform,
+// flattens nested lists and puts a BVH over lists with more than a few children.
+// Works through lists, transforms and medium boundaries, the list BVHs are built with options.
+// Shared objects are never modified, what changes below them is rebuilt.
+inline std::shared_ptr<Hittable> finalize_hittable(const std::shared_ptr<Hittable>& object,
+                                                   const BVHBuildOptions& options) {
+    switch (object->type) {
+        case HittableType_Translate:
+        case HittableType_RotateY:
+        case HittableType_Transform: {
+            Affine3 to_world;
+            std::shared_ptr<Hittable> inner = object;
+            while (true) {
+                if (inner->type == HittableType_Translate) {
+                    auto translate = std::static_pointer_cast<Translate>(inner);
+                    to_world = to_world * Affine3::translate(translate->get_offset());
+                    inner = translate->get_object();
+                }
+                else if (inner->type == HittableType_RotateY) {
+                    auto rotate = std::static_pointer_cast<RotateY>(inner);
+                    to_world = to_world * Affine3::rotate_y(rotate->get_angle());
+                    inner = rotate->get_object();
+                }
+                else if (inner->type == HittableType_Transform) {
+                    auto transform = std::static_pointer_cast<Transform>(inner);
+                    to_world = to_world * transform->get_to_world();
+                    inner = transform->get_object();
+                }
+                else break;
+            }
+            return std::make_shared<Transform>(finalize_hittable(inner, options), to_world);
+        }
+        case HittableType_List: {
+            std::vector<std::shared_ptr<Hittable>> children;
+            append_flattened(children, object, options);
+            if (children.size() > finalize_list_bvh_min_size) {
+                return std::make_shared<LinearBVH>(children, options);
+            }
+            // a new list, the original may be shared with other parts of the scene
+            return std::make_shared<HittableList>(children);
+        }
+        case HittableType_ConstantMedium: {
+            auto medium = std::static_pointer_cast<ConstantMedium>(object);
+            return std::make_shared<ConstantMedium>(*medium, finalize_hittable(medium->get_boundary(), options));
+        }
+        default:
+            return object;
+    }
+}
+
+// Registers the materials of every primitive under object in the table and stores their indices.
+// Shared objects (instanced BVHs) are visited once per reference, the table keeps one entry per material.
+inline void bind_materials(Hittable* object, MaterialTable& table) {
+    switch (object->type) {
+        case HittableType_BVH_Node: {
+            BVH_Node* node = static_cast<BVH_Node*>(object);
+            bind_materials(node->left.get(), table);
+            if (node->right != node->left) bind_materials(node->right.get(), table);
+            break;
+        }
+        case HittableType_List:
+            for (const auto& child: static_cast<HittableList*>(object)->objects) {
+                bind_materials(child.get(), table);
+            }
+            break;
+        case HittableType_LinearBVH:
+            for (const auto& child: static_cast<LinearBVH*>(object)->get_objects()) {
+                bind_materials(child.get(), table);
+            }
+            break;
+        case HittableType_Translate:
+            bind_materials(static_cast<Translate*>(object)->get_object().get(), table);
+            break;
+        case HittableType_RotateY:
+            bind_materials(static_cast<RotateY*>(object)->get_object().get(), table);
+            break;
+        case HittableType_Transform:
+        case HittableType_Instance:
+            bind_materials(static_cast<Transform*>(object)->get_object().get(), table);
+            break;
+        case HittableType_ConstantMedium: {
+            ConstantMedium* medium = static_cast<ConstantMedium*>(object);
+            medium->bind_material(table);
+            bind_materials(medium->get_boundary().get(), table);
+            break;
+        }
+        case HittableType_Sphere:
+            static_cast<Sphere*>(object)->bind_material(table);
+            break;
+        case HittableType_Quad:
+            static_cast<Quad*>(object)->bind_material(table);
+            break;
+        case HittableType_Mesh:
+            static_cast<Mesh*>(object)->bind_material(table);
+            break;
+        case HittableType_SphereSet:
+            break; // built with table indices
+    }
+}
+
+// Adds the emissive spheres and parallelograms under object to the light list and stores their index.
+// Only lists and BVHs are walked: a light under a transform or an instance is only found by bounces.
+inline void collect_lights(Hittable* object, const MaterialTable& table, LightList& lights) {
+    switch (object->type) {
+        case HittableType_BVH_Node: {
+            BVH_Node* node = static_cast<BVH_Node*>(object);
+            collect_lights(node->left.get(), table, lights);
+            if (node->right != node->left) collect_lights(node->right.get(), table, lights);
+            break;
+        }
+        case HittableType_List:
+            for (const auto& child: static_cast<HittableList*>(object)->objects) {
+                collect_lights(child.get(), table, lights);
+            }
+            break;
+        case HittableType_LinearBVH:
+            for (const auto& child: static_cast<LinearBVH*>(object)->get_objects()) {
+                collect_lights(child.get(), table, lights);
+            }
+            break;
+        case HittableType_Sphere: {
+            Sphere* sphere = static_cast<Sphere*>(object);
+            if (sphere->light < 0 && (table.flags(sphere->material.id) & MaterialFlag_Emissive)) {
+                sphere->light = lights.add(sphere, table);
+            }
+            break;
+        }
+        case HittableType_Quad: {
+            Quad* quad = static_cast<Quad*>(object);
+            if (quad->light < 0 && quad->is_parallelogram() && (table.flags(quad->material_id()) & MaterialFlag_Emissive)) {
+                quad->light = lights.add(quad, table);
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+#endif /* finalize_h */
@@ -21,6 +21,79 @@ bool Hittable::hit(const Ray& ray, const Interval& limits, Hit& hit) {
             return (static_cast<Quad*>(this))->hit(ray, limits, hit);
         case HittableType_ConstantMedium:
             return (static_cast<ConstantMedium*>(this))->hit(ray, limits, hit);
+        case HittableType_LinearBVH:
+            return (static_cast<LinearBVH*>(this))->hit(ray, limits, hit);
+        case HittableType_Instance:
+            return (static_cast<Instance*>(this))->hit(ray, limits, hit);
+        case HittableType_Transform:
+            return (static_cast<Transform*>(this))->hit(ray, limits, hit);
+        case HittableType_Mesh:
+            return (static_cast<Mesh*>(this))->hit(ray, limits, hit);
+        case HittableType_SphereSet:
+            return (static_cast<SphereSet*>(this))->hit(ray, limits, hit);
+    }
+    std::cout << "Unhandled hittable in: " << __FUNCTION__ << std::endl;
+    exit(1);
+}
+
+bool Hittable::occluded(const Ray& ray, const Interval& limits) {
+    switch (this->type) {
+        case HittableType_BVH_Node:
+            return (static_cast<BVH_Node*>(this))->occluded(ray, limits);
+        case HittableType_List:
+            return (static_cast<HittableList*>(this))->occluded(ray, limits);
+        case HittableType_Translate:
+            return (static_cast<Translate*>(this))->occluded(ray, limits);
+        case HittableType_RotateY:
+            return (static_cast<RotateY*>(this))->occluded(ray, limits);
+        case HittableType_Sphere:
+            return (static_cast<Sphere*>(this))->occluded(ray, limits);
+        case HittableType_Quad:
+            return (static_cast<Quad*>(this))->occluded(ray, limits);
+        case HittableType_ConstantMedium:
+            return (static_cast<ConstantMedium*>(this))->occluded(ray, limits);
+        case HittableType_LinearBVH:
+            return (static_cast<LinearBVH*>(this))->occluded(ray, limits);
+        case HittableType_Instance:
+            return (static_cast<Instance*>(this))->occluded(ray, limits);
+        case HittableType_Transform:
+            return (static_cast<Transform*>(this))->occluded(ray, limits);
+        case HittableType_Mesh:
+            return (static_cast<Mesh*>(this))->occluded(ray, limits);
+        case HittableType_SphereSet:
+            return (static_cast<SphereSet*>(this))->occluded(ray, limits);
+    }
+    std::cout << "Unhandled hittable in: " << __FUNCTION__ << std::endl;
+    exit(1);
+}
+
+bool Hittable::hit_deferred(const Ray& ray, const Interval& limits, Hit& hit, bool& deferred) {
+    double d;
+    switch (this->type) {
+        case HittableType_Sphere:
+            deferred = true;
+            if (!(static_cast<Sphere*>(this))->hit_distance(ray, limits, d)) return false;
+            hit.d = d;
+            return true;
+        case HittableType_Quad:
+            deferred = true;
+            if (!(static_cast<Quad*>(this))->hit_distance(ray, limits, d)) return false;
+            hit.d = d;
+            return true;
+        default:
+            deferred = false;
+            return this->hit(ray, limits, hit);
+    }
+}
+
+void Hittable::finish_hit(const Ray& ray, Hit& hit) {
+    switch (this->type) {
+        case HittableType_Sphere:
+            return (static_cast<Sphere*>(this))->finish_hit(ray, hit);
+        case HittableType_Quad:
+            return (static_cast<Quad*>(this))->finish_hit(ray, hit);
+        default:
+            return;
     }
 }
 
@@ -40,7 +113,19 @@ AABB Hittable::bounding_box() {
             return (static_cast<Quad*>(this))->bounding_box();
         case HittableType_ConstantMedium:
             return (static_cast<ConstantMedium*>(this))->bounding_box();
+        case HittableType_LinearBVH:
+            return (static_cast<LinearBVH*>(this))->bounding_box();
+        case HittableType_Instance:
+            return (static_cast<Instance*>(this))->bounding_box();
+        case HittableType_Transform:
+            return (static_cast<Transform*>(this))->bounding_box();
+        case HittableType_Mesh:
+            return (static_cast<Mesh*>(this))->bounding_box();
+        case HittableType_SphereSet:
+            return (static_cast<SphereSet*>(this))->bounding_box();
     }
+    std::cout << "Unhandled hittable in: " << __FUNCTION__ << std::endl;
+    exit(1);
 }
 
 #endif /* hit_polymorph_h */
@@ -1,6 +1,7 @@
 #ifndef hittable_h
 #define hittable_h
 
+#include <cstdint>
 #include "../math/vec3.h"
 class Material;
 class Ray;
@@ -12,9 +13,10 @@ public:
     Vec3 p;
     Vec3 n;
     double d; // distance from ray origin
-    Material* material; // raw pointer up to 30% faster than shared_ptr (many assignments)
     double u;
     double v;
+    uint32_t material; // index into the scene's MaterialTable
+    int32_t light;     // index into the scene's LightList, -1 for surfaces that aren't sampled as lights
     bool is_front;
     
     inline void set_normal(const Ray& r, const Vec3& outward_normal) {
@@ -31,6 +33,11 @@ typedef enum {
     HittableType_Sphere,
     HittableType_Quad,
     HittableType_ConstantMedium,
+    HittableType_LinearBVH,
+    HittableType_Instance,
+    HittableType_Transform,
+    HittableType_Mesh,
+    HittableType_SphereSet,
 } HittableType;
 
 
@@ -41,8 +48,16 @@ public:
     Hittable(HittableType type): type(type) { }
     
     inline bool hit(const Ray& ray, const Interval& limits, Hit& hit);
+    // true if anything blocks the ray within limits, no hit attributes are computed
+    inline bool occluded(const Ray& ray, const Interval& limits);
     inline AABB bounding_box();
     
+    // Closest hit that leaves the surface attributes for later when the type can compute them
+    // from the distance alone (spheres and quads): sets deferred and only hit.d, finish_hit completes the hit.
+    // Other types do a full hit. Used by containers, only their closest hit pays for normals and uv.
+    inline bool hit_deferred(const Ray& ray, const Interval& limits, Hit& hit, bool& deferred);
+    inline void finish_hit(const Ray& ray, Hit& hit);
+    
     // Tried avoiding v-tables, but wasn't much faster, time is spent elsewhere.
     // Also, hard to do static dispatch at this point,
     // because logic is in headers, and cyclic dependencies cause errors
@@ -67,7 +82,15 @@ class Translate : public Hittable {
         return true;
     }
     
+    bool occluded(const Ray& r, const Interval& limits) const {
+        Ray offset_r(r.origin() - offset, r.dir(), r.time());
+        return object->occluded(offset_r, limits);
+    }
+    
     AABB bounding_box() const { return bbox; }
+    
+    const shared_ptr<Hittable>& get_object() const { return object; }
+    const Vec3& get_offset() const { return offset; }
 
   private:
     shared_ptr<Hittable> object;
@@ -79,7 +102,7 @@ class Translate : public Hittable {
 class RotateY : public Hittable {
   public:
     
-    RotateY(shared_ptr<Hittable> object, double angle) : Hittable(HittableType_RotateY), object(object) {
+    RotateY(shared_ptr<Hittable> object, double angle) : Hittable(HittableType_RotateY), object(object), angle(angle) {
         auto radians = rad_from_deg(angle);
         sin_theta = std::sin(radians);
         cos_theta = std::cos(radians);
@@ -111,10 +134,8 @@ class RotateY : public Hittable {
         bbox = AABB(min, max);
     }
 
-    bool hit(const Ray& r, const Interval& limits, Hit& hit) const {
-
-        // Transform the ray from world space to object space.
-
+    // Transform the ray from world space to object space.
+    Ray to_object(const Ray& r) const {
         auto origin = Vec3(
             (cos_theta * r.origin().X()) - (sin_theta * r.origin().Z()),
             r.origin().Y(),
@@ -127,7 +148,12 @@ class RotateY : public Hittable {
             (sin_theta * r.dir().X()) + (cos_theta * r.dir().Z())
         );
 
-        Ray rotated_r(origin, direction, r.time());
+        return Ray(origin, direction, r.time());
+    }
+
+    bool hit(const Ray& r, const Interval& limits, Hit& hit) const {
+
+        Ray rotated_r = to_object(r);
 
         // Determine whether an intersection exists in object space (and if so, where).
 
@@ -151,10 +177,18 @@ class RotateY : public Hittable {
         return true;
     }
     
+    bool occluded(const Ray& r, const Interval& limits) const {
+        return object->occluded(to_object(r), limits);
+    }
+    
     AABB bounding_box() const { return bbox; }
     
+    const shared_ptr<Hittable>& get_object() const { return object; }
+    double get_angle() const { return angle; }
+    
 private:
     shared_ptr<Hittable> object;
+    double angle; // degrees
     double sin_theta;
     double cos_theta;
     AABB bbox;
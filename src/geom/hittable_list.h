@@ -15,7 +15,7 @@ class HittableList : public Hittable {
     HittableList(shared_ptr<Hittable> object): Hittable(HittableType_List) {
         add(object);
     }
-    HittableList(vector<shared_ptr<Hittable>> objects): Hittable(HittableType_List), objects(objects) {
+    HittableList(vector<shared_ptr<Hittable>> objects): Hittable(HittableType_List) {
         for (auto obj: objects) {
             add(obj); // add updates the bounding box
         }
@@ -29,20 +29,39 @@ class HittableList : public Hittable {
     }
 
     bool hit(const Ray& r, const Interval& limits, Hit& hit) const {
+        if (!bbox.hit(r, limits))
+            return false;
+        
         Hit tmp_hit;
         bool hit_anything = false;
         auto closest_so_far = limits.max;
+        Hittable* deferred_object = nullptr; // closest hit still needs its surface attributes
 
         for (const auto& object : objects) {
-            if (object->hit(r, Interval(limits.min, closest_so_far), tmp_hit)) {
+            bool deferred;
+            if (object->hit_deferred(r, Interval(limits.min, closest_so_far), tmp_hit, deferred)) {
                 hit_anything = true;
                 closest_so_far = tmp_hit.d;
                 hit = tmp_hit;
+                deferred_object = deferred ? object.get() : nullptr;
             }
         }
+        if (deferred_object) {
+            deferred_object->finish_hit(r, hit);
+        }
         return hit_anything;
     }
 
+    bool occluded(const Ray& r, const Interval& limits) const {
+        if (!bbox.hit(r, limits))
+            return false;
+        for (const auto& object : objects) {
+            if (object->occluded(r, limits))
+                return true;
+        }
+        return false;
+    }
+
     AABB bounding_box() const { return bbox; }
 
   private:
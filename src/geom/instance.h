@@ -0,0 +1,36 @@
+#ifndef instance_h
+#define instance_h
+
+#include <memory>
+#include "transform.h"
+#include "linear_bvh.h"
+
+// Top level entry of a two level BVH: a shared bottom level BVH placed with an affine transform.
+// The BVH is built once in object space and reused by every instance of it,
+// the ray is transformed once on entry instead of going through Translate/RotateY chains.
+// Same as a Transform, without the dispatch on the wrapped object's type.
+class Instance: public Transform {
+public:
+    Instance(std::shared_ptr<LinearBVH> blas, const Affine3& to_world)
+    : Transform(blas, to_world, HittableType_Instance), blas(blas.get()) { }
+
+    bool hit(const Ray& r, const Interval& limits, Hit& hit) const {
+        double scale;
+        Ray object_r = to_object_ray(r, scale);
+        if (!blas->hit(object_r, object_limits(limits, scale), hit))
+            return false;
+        to_world_hit(hit, scale);
+        return true;
+    }
+
+    bool occluded(const Ray& r, const Interval& limits) const {
+        double scale;
+        Ray object_r = to_object_ray(r, scale);
+        return blas->occluded(object_r, object_limits(limits, scale));
+    }
+
+private:
+    const LinearBVH* blas; // owned through Transform::object
+};
+
+#endif /* instance_h */
@@ -0,0 +1,206 @@
+#ifndef linear_bvh_h
+#define linear_bvh_h
+
+#include <vector>
+#include <memory>
+#include "hittable.h"
+#include "bvh_tree.h"
+#include "wide_bvh.h"
+#include "prim_batch.h"
+
+// BVH over Hittables, usable anywhere a Hittable is.
+// Spheres and quads sharing a leaf are intersected together in SIMD batches.
+class LinearBVH: public Hittable {
+public:
+
+    LinearBVH(const std::vector<std::shared_ptr<Hittable>>& objects,
+              const BVHBuildOptions& options = BVHBuildOptions())
+    : Hittable(HittableType_LinearBVH), objects(objects)
+    {
+        // bounds computed once, the builder never goes back to the objects
+        std::vector<BVHPrimitive> prims(objects.size());
+        auto make_prims = [&prims, &objects](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                prims[i] = BVHPrimitive(objects[i]->bounding_box(), (uint32_t) i);
+            }
+        };
+        if (options.pool && (int) objects.size() >= options.parallel_min_size) {
+            options.pool->parallel_for(objects.size(), options.parallel_min_size, make_prims);
+        }
+        else {
+            make_prims(0, objects.size());
+        }
+
+        // mostly batchable primitives: larger leaves, priced per batch
+        BVHBuildOptions build_options = options;
+        size_t batchable = 0;
+        for (const auto& object: objects) {
+            batchable += prim_batch_kind(object.get()) != PrimBatchKind_None;
+        }
+        if (options.batch_leaves && batchable * 2 >= objects.size()) {
+            build_options.leaf_batch_width = PRIM_BATCH_WIDTH;
+            build_options.max_leaf_size = std::max(options.max_leaf_size, 2 * PRIM_BATCH_WIDTH);
+        }
+
+        tree.build(prims, build_options);
+        use_wide = options.use_wide(objects.size());
+        if (use_wide) {
+            wide_tree.build(tree);
+        }
+
+        // leaf order, no indirection through tree.indices during traversal
+        primitives.resize(objects.size());
+        for (size_t i = 0; i < objects.size(); i++) {
+            primitives[i] = objects[tree.indices[i]].get();
+        }
+        pack_leaves(options.batch_leaves);
+    }
+
+    AABB bounding_box() const {
+        return tree.bbox;
+    }
+    
+    double sah_cost() const {
+        return tree.sah_cost();
+    }
+    
+    size_t node_count() const {
+        return tree.nodes.size();
+    }
+    
+    const BVHTree& binary_tree() const {
+        return tree;
+    }
+    
+    const std::vector<std::shared_ptr<Hittable>>& get_objects() const {
+        return objects;
+    }
+
+    // Spheres and quads only record their distance during traversal,
+    // the closest one computes its surface attributes at the end
+    bool hit(const Ray& ray, const Interval& limits, Hit& hit) const {
+        Hittable* deferred = nullptr;
+        auto leaf_hit = [this, &deferred](uint32_t first, uint32_t count, const Ray& r, Interval l, Hit& h) {
+            bool found = false;
+            for (uint32_t i = first; i < first + count; i += slots[i].count) {
+                const LeafSlot& slot = slots[i];
+                if (slot.kind == PrimBatchKind_None) {
+                    bool is_deferred;
+                    if (!primitives[i]->hit_deferred(r, l, h, is_deferred)) continue;
+                    deferred = is_deferred ? primitives[i] : nullptr;
+                }
+                else {
+                    int lane = batch_nearest(slot, r, l, h.d);
+                    if (lane < 0) continue;
+                    deferred = primitives[i + lane];
+                }
+                found = true;
+                l.max = h.d;
+            }
+            return found;
+        };
+        bool found = use_wide ? wide_tree.traverse(ray, limits, hit, leaf_hit)
+                              : tree.traverse(ray, limits, hit, leaf_hit);
+        if (found && deferred) {
+            deferred->finish_hit(ray, hit);
+        }
+        return found;
+    }
+
+    bool occluded(const Ray& ray, const Interval& limits) const {
+        auto leaf_occluded = [this](uint32_t first, uint32_t count, const Ray& r, const Interval& l) {
+            for (uint32_t i = first; i < first + count; i += slots[i].count) {
+                const LeafSlot& slot = slots[i];
+                if (slot.kind == PrimBatchKind_None) {
+                    if (primitives[i]->occluded(r, l)) return true;
+                }
+                else {
+                    double t[PRIM_BATCH_WIDTH];
+                    if (batch_intersect(slot, r, l, t)) return true;
+                }
+            }
+            return false;
+        };
+        if (use_wide) {
+            return wide_tree.occluded(ray, limits, leaf_occluded);
+        }
+        return tree.occluded(ray, limits, leaf_occluded);
+    }
+
+private:
+    // First slot of a batch, or a primitive tested on its own (kind none, count 1).
+    // Slots inside a batch are skipped.
+    struct LeafSlot {
+        PrimBatchKind kind;
+        uint8_t count;
+        uint32_t batch;
+    };
+
+    std::vector<std::shared_ptr<Hittable>> objects; // owns the primitives
+    std::vector<Hittable*> primitives;
+    std::vector<LeafSlot> slots; // one per primitive
+    std::vector<SphereBatch> sphere_batches;
+    std::vector<QuadBatch> quad_batches;
+    BVHTree tree;
+    WideBVHTree<WIDE_BVH_WIDTH> wide_tree;
+    bool use_wide;
+
+    // Sorts each leaf by primitive kind and packs runs of 2 or more spheres or quads into batches
+    void pack_leaves(bool batch) {
+        slots.assign(primitives.size(), LeafSlot { PrimBatchKind_None, 1, 0 });
+        if (!batch) return;
+
+        for (const LinearBVHNode& node: tree.nodes) {
+            if (!node.is_leaf()) continue;
+            const uint32_t end = node.offset + node.count;
+            std::stable_sort(primitives.begin() + node.offset, primitives.begin() + end,
+                             [](const Hittable* a, const Hittable* b) {
+                return prim_batch_kind(a) > prim_batch_kind(b);
+            });
+
+            uint32_t i = node.offset;
+            while (i < end) {
+                const PrimBatchKind kind = prim_batch_kind(primitives[i]);
+                uint32_t n = 1;
+                while (n < PRIM_BATCH_WIDTH && i + n < end && prim_batch_kind(primitives[i + n]) == kind) n++;
+                if (kind == PrimBatchKind_None || n < 2) {
+                    i += n;
+                    continue;
+                }
+                LeafSlot& slot = slots[i];
+                slot.kind = kind;
+                slot.count = (uint8_t) n;
+                if (kind == PrimBatchKind_Sphere) {
+                    slot.batch = (uint32_t) sphere_batches.size();
+                    SphereBatch& b = sphere_batches.emplace_back();
+                    for (uint32_t lane = 0; lane < n; lane++) b.set(lane, *static_cast<Sphere*>(primitives[i + lane]));
+                }
+                else {
+                    slot.batch = (uint32_t) quad_batches.size();
+                    QuadBatch& b = quad_batches.emplace_back();
+                    for (uint32_t lane = 0; lane < n; lane++) b.set(lane, *static_cast<Quad*>(primitives[i + lane]));
+                }
+                i += n;
+            }
+        }
+    }
+
+    int batch_intersect(const LeafSlot& slot, const Ray& r, const Interval& l, double t[PRIM_BATCH_WIDTH]) const {
+        return slot.kind == PrimBatchKind_Sphere ? sphere_batches[slot.batch].intersect(r, l, t)
+                                                 : quad_batches[slot.batch].intersect(r, l, t);
+    }
+
+    // Lane of the nearest hit in the batch and its distance, -1 on a miss
+    int batch_nearest(const LeafSlot& slot, const Ray& r, const Interval& l, double& d) const {
+        double t[PRIM_BATCH_WIDTH];
+        int mask = batch_intersect(slot, r, l, t);
+        int nearest = -1;
+        for (int lane = 0; lane < PRIM_BATCH_WIDTH; lane++) {
+            if (((mask >> lane) & 1) && (nearest < 0 || t[lane] < t[nearest])) nearest = lane;
+        }
+        if (nearest >= 0) d = t[nearest];
+        return nearest;
+    }
+};
+
+#endif /* linear_bvh_h */
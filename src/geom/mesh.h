@@ -0,0 +1,218 @@
+#ifndef mesh_h
+#define mesh_h
+
+#include <vector>
+#include <memory>
+#include <cmath>
+#include <cstdint>
+#include "hittable.h"
+#include "../material_table.h"
+#include "bvh_tree.h"
+#include "wide_bvh.h"
+
+// Indexed triangle mesh with its own bottom level BVH.
+// Vertex attributes are shared arrays, a triangle is three vertex indices,
+// so the per triangle cost is the indices plus its share of the BVH nodes.
+// The BVH reorders the triangles, leaf slots are triangle numbers.
+class Mesh: public Hittable {
+public:
+    std::vector<Vec3> positions;
+    std::vector<Vec3> normals; // per vertex, empty for flat shading
+    std::vector<float> uvs;    // u, v per vertex, may be empty
+    std::vector<uint32_t> indices; // 3 per triangle
+
+    Mesh(std::vector<Vec3> positions, std::vector<uint32_t> indices, std::shared_ptr<Material> material,
+         std::vector<Vec3> normals = {}, std::vector<float> uvs = {},
+         const BVHBuildOptions& options = BVHBuildOptions())
+    : Hittable(HittableType_Mesh),
+      positions(std::move(positions)), normals(std::move(normals)), uvs(std::move(uvs)),
+      indices(std::move(indices)), material(material)
+    {
+        build(options);
+    }
+
+    size_t triangle_count() const {
+        return indices.size() / 3;
+    }
+
+    // Heap memory held by the mesh: attributes, indices and BVH
+    size_t memory_bytes() const {
+        return positions.capacity() * sizeof(Vec3)
+             + normals.capacity() * sizeof(Vec3)
+             + uvs.capacity() * sizeof(float)
+             + indices.capacity() * sizeof(uint32_t)
+             + tree.nodes.capacity() * sizeof(LinearBVHNode)
+             + wide_tree.nodes.capacity() * sizeof(WideBVHNode<WIDE_BVH_WIDTH>);
+    }
+
+    AABB bounding_box() const {
+        return tree.bbox;
+    }
+
+    void bind_material(MaterialTable& table) {
+        material.bind(table);
+    }
+
+    bool hit(const Ray& ray, const Interval& limits, Hit& hit) const {
+        const WatertightRay wray(ray);
+        uint32_t hit_triangle = 0;
+        double b1 = 0, b2 = 0;
+        auto leaf_hit = [this, &wray, &hit_triangle, &b1, &b2](uint32_t first, uint32_t count, const Ray&, Interval l, Hit& h) {
+            bool found = false;
+            for (uint32_t i = first; i < first + count; i++) {
+                double t, u, v;
+                if (!intersect(i, wray, l, t, u, v)) continue;
+                h.d = l.max = t;
+                hit_triangle = i;
+                b1 = u;
+                b2 = v;
+                found = true;
+            }
+            return found;
+        };
+        bool found = use_wide ? wide_tree.traverse(ray, limits, hit, leaf_hit)
+                              : tree.traverse(ray, limits, hit, leaf_hit);
+        if (!found) return false;
+
+        // attributes only for the closest triangle
+        const uint32_t* tri = &indices[3 * hit_triangle];
+        double b0 = 1.0 - b1 - b2;
+        hit.p = ray.at(hit.d);
+        Vec3 normal;
+        if (!normals.empty()) {
+            normal = norm(b0 * normals[tri[0]] + b1 * normals[tri[1]] + b2 * normals[tri[2]]);
+        }
+        else {
+            normal = norm(cross(positions[tri[1]] - positions[tri[0]], positions[tri[2]] - positions[tri[0]]));
+        }
+        hit.set_normal(ray, normal);
+        if (!material.needs_uv) {
+            hit.u = hit.v = 0;
+        }
+        else if (!uvs.empty()) {
+            hit.u = b0 * uvs[2 * tri[0]] + b1 * uvs[2 * tri[1]] + b2 * uvs[2 * tri[2]];
+            hit.v = b0 * uvs[2 * tri[0] + 1] + b1 * uvs[2 * tri[1] + 1] + b2 * uvs[2 * tri[2] + 1];
+        }
+        else {
+            hit.u = b1;
+            hit.v = b2;
+        }
+        hit.material = material.id;
+        hit.light = -1;
+        return true;
+    }
+
+    bool occluded(const Ray& ray, const Interval& limits) const {
+        const WatertightRay wray(ray);
+        auto leaf_occluded = [this, &wray](uint32_t first, uint32_t count, const Ray&, const Interval& l) {
+            for (uint32_t i = first; i < first + count; i++) {
+                double t, u, v;
+                if (intersect(i, wray, l, t, u, v)) return true;
+            }
+            return false;
+        };
+        if (use_wide) {
+            return wide_tree.occluded(ray, limits, leaf_occluded);
+        }
+        return tree.occluded(ray, limits, leaf_occluded);
+    }
+
+private:
+    MaterialRef material;
+    BVHTree tree;
+    WideBVHTree<WIDE_BVH_WIDTH> wide_tree;
+    bool use_wide;
+
+    // Per ray setup of the watertight test (Woop, Benthin, Wald 2013):
+    // the axes are permuted so z is the dominant direction axis, then sheared so the ray is +z
+    struct WatertightRay {
+        Vec3 origin;
+        int kx, ky, kz;
+        double sx, sy, sz;
+
+        WatertightRay(const Ray& ray) : origin(ray.origin()) {
+            const Vec3& d = ray.dir();
+            kz = 0;
+            if (std::fabs(d[1]) > std::fabs(d[kz])) kz = 1;
+            if (std::fabs(d[2]) > std::fabs(d[kz])) kz = 2;
+            kx = kz == 2 ? 0 : kz + 1;
+            ky = kx == 2 ? 0 : kx + 1;
+            if (d[kz] < 0) std::swap(kx, ky); // keeps the winding
+            sx = d[kx] / d[kz];
+            sy = d[ky] / d[kz];
+            sz = 1.0 / d[kz];
+        }
+    };
+
+    // Edge functions of the sheared triangle, no gaps or double hits on shared edges.
+    // u, v are the barycentric weights of the second and third vertex.
+    inline bool intersect(uint32_t triangle, const WatertightRay& ray, const Interval& limits,
+                          double& t, double& u, double& v) const
+    {
+        const uint32_t* tri = &indices[3 * triangle];
+        const Vec3 a = positions[tri[0]] - ray.origin;
+        const Vec3 b = positions[tri[1]] - ray.origin;
+        const Vec3 c = positions[tri[2]] - ray.origin;
+
+        const double ax = a[ray.kx] - ray.sx * a[ray.kz];
+        const double ay = a[ray.ky] - ray.sy * a[ray.kz];
+        const double bx = b[ray.kx] - ray.sx * b[ray.kz];
+        const double by = b[ray.ky] - ray.sy * b[ray.kz];
+        const double cx = c[ray.kx] - ray.sx * c[ray.kz];
+        const double cy = c[ray.ky] - ray.sy * c[ray.kz];
+
+        const double e0 = cx * by - cy * bx; // weight of a
+        const double e1 = ax * cy - ay * cx; // weight of b
+        const double e2 = bx * ay - by * ax; // weight of c
+        if ((e0 < 0 || e1 < 0 || e2 < 0) && (e0 > 0 || e1 > 0 || e2 > 0)) return false;
+
+        const double det = e0 + e1 + e2;
+        if (det == 0) return false;
+
+        const double inv_det = 1.0 / det;
+        t = (e0 * a[ray.kz] + e1 * b[ray.kz] + e2 * c[ray.kz]) * ray.sz * inv_det;
+        if (!limits.surrounds(t)) return false;
+        u = e1 * inv_det;
+        v = e2 * inv_det;
+        return true;
+    }
+
+    void build(const BVHBuildOptions& options) {
+        const size_t count = triangle_count();
+        std::vector<BVHPrimitive> prims(count);
+        auto make_prims = [this, &prims](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                const uint32_t* tri = &indices[3 * i];
+                AABB box(AABB(positions[tri[0]], positions[tri[1]]), AABB(positions[tri[2]], positions[tri[2]]));
+                prims[i] = BVHPrimitive(box, (uint32_t) i);
+            }
+        };
+        if (options.pool && (int) count >= options.parallel_min_size) {
+            options.pool->parallel_for(count, options.parallel_min_size, make_prims);
+        }
+        else {
+            make_prims(0, count);
+        }
+        tree.build(prims, options);
+        use_wide = options.use_wide(count);
+        if (use_wide) {
+            wide_tree.build(tree);
+        }
+
+        // triangles in leaf order, the slot order is no longer needed
+        std::vector<uint32_t> ordered(indices.size());
+        for (size_t i = 0; i < count; i++) {
+            uint32_t src = tree.indices[i];
+            ordered[3 * i]     = indices[3 * src];
+            ordered[3 * i + 1] = indices[3 * src + 1];
+            ordered[3 * i + 2] = indices[3 * src + 2];
+        }
+        indices = std::move(ordered);
+        tree.indices = std::vector<uint32_t>();
+        if (use_wide) {
+            tree.nodes = std::vector<LinearBVHNode>(); // only the wide tree is traversed
+        }
+    }
+};
+
+#endif /* mesh_h */
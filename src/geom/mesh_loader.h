@@ -0,0 +1,659 @@
+#ifndef mesh_loader_h
+#define mesh_loader_h
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <functional>
+#include <algorithm>
+#include <filesystem>
+#include <cctype>
+#include <cstring>
+#include <cstdint>
+#include <cmath>
+#include <chrono>
+#include <iostream>
+#include "mesh.h"
+#include "../util/mapped_file.h"
+#include "../util/work_stealing_pool.h"
+
+// Wavefront OBJ and binary PLY loading into Mesh buffers.
+// Files are memory mapped and parsed in place, the final arrays are sized by a counting pass
+// and written once. OBJ files are parsed in parallel chunks when a pool is given.
+// OBJ: v, vt, vn and polygonal f (fan triangulated), other statements are ignored.
+// PLY: binary little or big endian, vertex x y z [nx ny nz] [u v | s t], face vertex_indices lists.
+
+
+// Buffers of a loaded mesh, moved into the Mesh
+struct MeshData {
+    std::vector<Vec3> positions;
+    std::vector<Vec3> normals;
+    std::vector<float> uvs;
+    std::vector<uint32_t> indices;
+};
+
+
+// ---- text parsing ----
+
+inline const char* mesh_skip_spaces(const char* p, const char* end) {
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    return p;
+}
+
+inline const char* mesh_next_line(const char* p, const char* end) {
+    const char* nl = (const char*) std::memchr(p, '\n', end - p);
+    return nl ? nl + 1 : end;
+}
+
+inline bool mesh_is_digit(char c) {
+    return (unsigned) (c - '0') < 10;
+}
+
+// Decimal with optional sign, fraction and exponent. Up to 19 significant digits are kept.
+inline bool mesh_parse_double(const char*& p, const char* end, double& out) {
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    p = mesh_skip_spaces(p, end);
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    uint64_t mantissa = 0;
+    int exponent = 0;
+    int digits = 0;
+    bool any = false;
+    for (; p < end && mesh_is_digit(*p); p++, any = true) {
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa) digits++;
+        }
+        else exponent++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        for (; p < end && mesh_is_digit(*p); p++, any = true) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa) digits++;
+                exponent--;
+            }
+        }
+    }
+    if (!any) return false;
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char* q = p + 1;
+        bool exp_negative = false;
+        if (q < end && (*q == '-' || *q == '+')) {
+            exp_negative = *q == '-';
+            q++;
+        }
+        if (q < end && mesh_is_digit(*q)) {
+            int e = 0;
+            for (; q < end && mesh_is_digit(*q); q++) {
+                if (e < 10000) e = e * 10 + (*q - '0');
+            }
+            exponent += exp_negative ? -e : e;
+            p = q;
+        }
+    }
+    double value = (double) mantissa;
+    if (exponent < 0) {
+        value = exponent >= -22 ? value / pow10[-exponent] : value * std::pow(10.0, exponent);
+    }
+    else if (exponent > 0) {
+        value = exponent <= 22 ? value * pow10[exponent] : value * std::pow(10.0, exponent);
+    }
+    out = negative ? -value : value;
+    return true;
+}
+
+inline bool mesh_parse_int(const char*& p, const char* end, int64_t& out) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = *p == '-';
+        p++;
+    }
+    if (p >= end || !mesh_is_digit(*p)) return false;
+    int64_t value = 0;
+    for (; p < end && mesh_is_digit(*p); p++) {
+        value = value * 10 + (*p - '0');
+    }
+    out = negative ? -value : value;
+    return true;
+}
+
+// The statement keyword of an OBJ line, followed by a space or tab
+inline bool obj_keyword(const char* p, const char* end, const char* keyword, size_t length) {
+    return (size_t) (end - p) > length && std::memcmp(p, keyword, length) == 0
+        && (p[length] == ' ' || p[length] == '\t');
+}
+
+
+// ---- OBJ ----
+
+struct ObjChunk {
+    const char* begin;
+    const char* end;
+    // counting pass, prefix sums turn them into write offsets
+    size_t positions = 0, normals = 0, uvs = 0, triangles = 0;
+    size_t position_offset = 0, normal_offset = 0, uv_offset = 0, triangle_offset = 0;
+    // parsing pass
+    bool bad = false;
+    bool missing_uv = false, missing_normal = false;   // a face corner without vt / vn
+    bool shared_uv = true, shared_normal = true;       // vt / vn index equals the v index
+};
+
+inline void obj_count(ObjChunk& chunk) {
+    for (const char* line = chunk.begin; line < chunk.end; line = mesh_next_line(line, chunk.end)) {
+        const char* p = mesh_skip_spaces(line, chunk.end);
+        if (obj_keyword(p, chunk.end, "v", 1)) chunk.positions++;
+        else if (obj_keyword(p, chunk.end, "vn", 2)) chunk.normals++;
+        else if (obj_keyword(p, chunk.end, "vt", 2)) chunk.uvs++;
+        else if (obj_keyword(p, chunk.end, "f", 1)) {
+            // corners are whitespace separated tokens up to the end of line or a comment
+            int corners = 0;
+            p += 1;
+            while (true) {
+                p = mesh_skip_spaces(p, chunk.end);
+                if (p >= chunk.end || *p == '\n' || *p == '#') break;
+                corners++;
+                while (p < chunk.end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') p++;
+            }
+            if (corners >= 3) chunk.triangles += corners - 2;
+        }
+    }
+}
+
+// 1 based or negative (relative) OBJ index to a 0 based index, -1 when out of range
+inline int64_t obj_resolve(int64_t index, size_t count) {
+    if (index > 0 && (size_t) index <= count) return index - 1;
+    if (index < 0 && (size_t) -index <= count) return (int64_t) count + index;
+    return -1;
+}
+
+// file_uvs and file_normals are indexed by vt / vn, uv_index and normal_index per face corner
+inline void obj_parse(ObjChunk& chunk, MeshData& data,
+                      std::vector<float>& file_uvs, std::vector<Vec3>& file_normals,
+                      std::vector<uint32_t>& uv_index, std::vector<uint32_t>& normal_index,
+                      size_t total_uvs, size_t total_normals)
+{
+    size_t positions = chunk.position_offset;
+    size_t normals = chunk.normal_offset;
+    size_t uvs = chunk.uv_offset;
+    size_t triangle = chunk.triangle_offset;
+    const char* end = chunk.end;
+
+    for (const char* line = chunk.begin; line < end; line = mesh_next_line(line, end)) {
+        const char* p = mesh_skip_spaces(line, end);
+
+        if (obj_keyword(p, end, "v", 1)) {
+            p += 1;
+            double x = 0, y = 0, z = 0;
+            if (!mesh_parse_double(p, end, x) || !mesh_parse_double(p, end, y) || !mesh_parse_double(p, end, z)) {
+                chunk.bad = true;
+                return;
+            }
+            data.positions[positions++] = Vec3(x, y, z);
+        }
+        else if (obj_keyword(p, end, "vn", 2)) {
+            p += 2;
+            double x = 0, y = 0, z = 0;
+            if (!mesh_parse_double(p, end, x) || !mesh_parse_double(p, end, y) || !mesh_parse_double(p, end, z)) {
+                chunk.bad = true;
+                return;
+            }
+            file_normals[normals++] = Vec3(x, y, z);
+        }
+        else if (obj_keyword(p, end, "vt", 2)) {
+            p += 2;
+            double u = 0, v = 0;
+            if (!mesh_parse_double(p, end, u)) {
+                chunk.bad = true;
+                return;
+            }
+            const char* q = p;
+            if (!mesh_parse_double(q, end, v)) v = 0; // 1D texture coordinate
+            else p = q;
+            file_uvs[2 * uvs] = (float) u;
+            file_uvs[2 * uvs + 1] = (float) v;
+            uvs++;
+        }
+        else if (obj_keyword(p, end, "f", 1)) {
+            p += 1;
+            // fan triangulation, only the first and the previous corner are kept
+            uint32_t first[3] = {}, previous[3] = {};
+            int corners = 0;
+            while (true) {
+                p = mesh_skip_spaces(p, end);
+                if (p >= end || *p == '\n' || *p == '#') break;
+
+                // v, v/vt, v//vn or v/vt/vn, indices relative to the elements defined so far
+                int64_t v = 0, vt = 0, vn = 0;
+                if (!mesh_parse_int(p, end, v)) {
+                    chunk.bad = true;
+                    return;
+                }
+                if (p < end && *p == '/') {
+                    p++;
+                    if (p < end && *p != '/') mesh_parse_int(p, end, vt);
+                    if (p < end && *p == '/') {
+                        p++;
+                        mesh_parse_int(p, end, vn);
+                    }
+                }
+                int64_t vi = obj_resolve(v, positions);
+                int64_t ti = vt ? obj_resolve(vt, uvs) : -1;
+                int64_t ni = vn ? obj_resolve(vn, normals) : -1;
+                if (vi < 0 || (vt && ti < 0) || (vn && ni < 0)) {
+                    chunk.bad = true;
+                    return;
+                }
+                if (!vt) chunk.missing_uv = true;
+                else if (ti != vi) chunk.shared_uv = false;
+                if (!vn) chunk.missing_normal = true;
+                else if (ni != vi) chunk.shared_normal = false;
+
+                uint32_t corner[3] = { (uint32_t) vi, (uint32_t) (ti < 0 ? 0 : ti), (uint32_t) (ni < 0 ? 0 : ni) };
+                if (corners == 0) {
+                    std::memcpy(first, corner, sizeof(corner));
+                }
+                else if (corners >= 2) {
+                    size_t k = 3 * triangle++;
+                    data.indices[k] = first[0];
+                    data.indices[k + 1] = previous[0];
+                    data.indices[k + 2] = corner[0];
+                    if (total_uvs) {
+                        uv_index[k] = first[1];
+                        uv_index[k + 1] = previous[1];
+                        uv_index[k + 2] = corner[1];
+                    }
+                    if (total_normals) {
+                        normal_index[k] = first[2];
+                        normal_index[k + 1] = previous[2];
+                        normal_index[k + 2] = corner[2];
+                    }
+                }
+                std::memcpy(previous, corner, sizeof(corner));
+                corners++;
+                while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') p++;
+            }
+        }
+    }
+}
+
+inline bool load_obj(const MappedFile& file, MeshData& data, WorkStealingPool* pool) {
+    const char* begin = file.data();
+    const char* end = begin + file.size();
+
+    // chunks end on line boundaries
+    size_t min_chunk = 1 << 20;
+    size_t chunk_count = pool ? std::max<size_t>(1, std::min(pool->size() * 4, file.size() / min_chunk)) : 1;
+    std::vector<ObjChunk> chunks;
+    const char* p = begin;
+    for (size_t i = 0; i < chunk_count && p < end; i++) {
+        const char* chunk_end = (i + 1 == chunk_count) ? end : begin + file.size() * (i + 1) / chunk_count;
+        if (chunk_end < p) chunk_end = p;
+        chunk_end = mesh_next_line(chunk_end, end);
+        ObjChunk chunk;
+        chunk.begin = p;
+        chunk.end = chunk_end;
+        chunks.push_back(chunk);
+        p = chunk_end;
+    }
+
+    auto for_chunks = [&chunks, pool](const std::function<void(ObjChunk&)>& fn) {
+        if (pool && chunks.size() > 1) {
+            pool->parallel_for(chunks.size(), 1, [&chunks, &fn](size_t b, size_t e) {
+                for (size_t i = b; i < e; i++) fn(chunks[i]);
+            });
+        }
+        else {
+            for (ObjChunk& chunk: chunks) fn(chunk);
+        }
+    };
+
+    for_chunks(obj_count);
+
+    size_t positions = 0, normals = 0, uvs = 0, triangles = 0;
+    for (ObjChunk& chunk: chunks) {
+        chunk.position_offset = positions;
+        chunk.normal_offset = normals;
+        chunk.uv_offset = uvs;
+        chunk.triangle_offset = triangles;
+        positions += chunk.positions;
+        normals += chunk.normals;
+        uvs += chunk.uvs;
+        triangles += chunk.triangles;
+    }
+
+    data.positions.resize(positions);
+    data.indices.resize(3 * triangles);
+    std::vector<float> file_uvs(2 * uvs);
+    std::vector<Vec3> file_normals(normals);
+    std::vector<uint32_t> uv_index(uvs ? 3 * triangles : 0);
+    std::vector<uint32_t> normal_index(normals ? 3 * triangles : 0);
+
+    for_chunks([&](ObjChunk& chunk) {
+        obj_parse(chunk, data, file_uvs, file_normals, uv_index, normal_index, uvs, normals);
+    });
+
+    bool missing_uv = uvs == 0, missing_normal = normals == 0;
+    bool shared_uv = true, shared_normal = true;
+    for (const ObjChunk& chunk: chunks) {
+        if (chunk.bad) return false;
+        missing_uv |= chunk.missing_uv;
+        missing_normal |= chunk.missing_normal;
+        shared_uv &= chunk.shared_uv;
+        shared_normal &= chunk.shared_normal;
+    }
+    // attributes indexed like the positions are used as they are
+    shared_uv &= uvs == positions;
+    shared_normal &= normals == positions;
+
+    bool use_uv = !missing_uv;
+    bool use_normal = !missing_normal;
+    if ((!use_uv || shared_uv) && (!use_normal || shared_normal)) {
+        if (use_uv) data.uvs = std::move(file_uvs);
+        if (use_normal) data.normals = std::move(file_normals);
+        return true;
+    }
+
+    // Mesh has one index per corner: split into one vertex per face corner
+    std::vector<Vec3> corner_positions(3 * triangles);
+    if (use_uv) data.uvs.resize(2 * 3 * triangles);
+    if (use_normal) data.normals.resize(3 * triangles);
+    auto expand = [&](size_t b, size_t e) {
+        for (size_t k = b; k < e; k++) {
+            corner_positions[k] = data.positions[data.indices[k]];
+            if (use_uv) {
+                data.uvs[2 * k] = file_uvs[2 * uv_index[k]];
+                data.uvs[2 * k + 1] = file_uvs[2 * uv_index[k] + 1];
+            }
+            if (use_normal) data.normals[k] = file_normals[normal_index[k]];
+            data.indices[k] = (uint32_t) k;
+        }
+    };
+    if (pool && triangles > (1 << 16)) {
+        pool->parallel_for(3 * triangles, 1 << 16, expand);
+    }
+    else {
+        expand(0, 3 * triangles);
+    }
+    data.positions = std::move(corner_positions);
+    return true;
+}
+
+
+// ---- PLY ----
+
+enum class PlyType { none, int8, uint8, int16, uint16, int32, uint32, float32, float64 };
+
+inline PlyType ply_type(const std::string& name) {
+    if (name == "char" || name == "int8") return PlyType::int8;
+    if (name == "uchar" || name == "uint8") return PlyType::uint8;
+    if (name == "short" || name == "int16") return PlyType::int16;
+    if (name == "ushort" || name == "uint16") return PlyType::uint16;
+    if (name == "int" || name == "int32") return PlyType::int32;
+    if (name == "uint" || name == "uint32") return PlyType::uint32;
+    if (name == "float" || name == "float32") return PlyType::float32;
+    if (name == "double" || name == "float64") return PlyType::float64;
+    return PlyType::none;
+}
+
+inline size_t ply_size(PlyType type) {
+    switch (type) {
+        case PlyType::int8: case PlyType::uint8: return 1;
+        case PlyType::int16: case PlyType::uint16: return 2;
+        case PlyType::int32: case PlyType::uint32: case PlyType::float32: return 4;
+        case PlyType::float64: return 8;
+        default: return 0;
+    }
+}
+
+inline double ply_read(const char* p, PlyType type, bool swap) {
+    unsigned char bytes[8];
+    size_t size = ply_size(type);
+    std::memcpy(bytes, p, size);
+    if (swap) std::reverse(bytes, bytes + size);
+    switch (type) {
+        case PlyType::int8:    { int8_t v;   std::memcpy(&v, bytes, 1); return v; }
+        case PlyType::uint8:   { uint8_t v;  std::memcpy(&v, bytes, 1); return v; }
+        case PlyType::int16:   { int16_t v;  std::memcpy(&v, bytes, 2); return v; }
+        case PlyType::uint16:  { uint16_t v; std::memcpy(&v, bytes, 2); return v; }
+        case PlyType::int32:   { int32_t v;  std::memcpy(&v, bytes, 4); return v; }
+        case PlyType::uint32:  { uint32_t v; std::memcpy(&v, bytes, 4); return v; }
+        case PlyType::float32: { float v;    std::memcpy(&v, bytes, 4); return v; }
+        case PlyType::float64: { double v;   std::memcpy(&v, bytes, 8); return v; }
+        default: return 0;
+    }
+}
+
+struct PlyProperty {
+    std::string name;
+    PlyType type = PlyType::none;
+    PlyType count_type = PlyType::none; // list properties only
+};
+
+struct PlyElement {
+    std::string name;
+    size_t count = 0;
+    std::vector<PlyProperty> properties;
+
+    // bytes per row when there are no list properties, 0 otherwise
+    size_t stride() const {
+        size_t size = 0;
+        for (const PlyProperty& property: properties) {
+            if (property.count_type != PlyType::none) return 0;
+            size += ply_size(property.type);
+        }
+        return size;
+    }
+};
+
+// Header line tokens, the header is small
+inline std::vector<std::string> ply_tokens(const char* p, const char* end) {
+    std::vector<std::string> tokens;
+    while (true) {
+        p = mesh_skip_spaces(p, end);
+        if (p >= end || *p == '\n') break;
+        const char* start = p;
+        while (p < end && *p != ' ' && *p != '\t' && *p != '\r' && *p != '\n') p++;
+        tokens.emplace_back(start, p);
+    }
+    return tokens;
+}
+
+inline bool load_ply(const MappedFile& file, MeshData& data, WorkStealingPool* pool) {
+    const char* p = file.data();
+    const char* end = p + file.size();
+    if (file.size() < 4 || std::memcmp(p, "ply", 3) != 0) return false;
+
+    bool swap = false;
+    bool host_little = true;
+    {
+        uint16_t probe = 1;
+        unsigned char first;
+        std::memcpy(&first, &probe, 1);
+        host_little = first == 1;
+    }
+    std::vector<PlyElement> elements;
+    bool header_done = false;
+    for (p = mesh_next_line(p, end); p < end; ) {
+        const char* line = p;
+        p = mesh_next_line(p, end);
+        std::vector<std::string> tokens = ply_tokens(line, p);
+        if (tokens.empty()) continue;
+        if (tokens[0] == "end_header") {
+            header_done = true;
+            break;
+        }
+        if (tokens[0] == "format" && tokens.size() >= 2) {
+            if (tokens[1] == "binary_little_endian") swap = !host_little;
+            else if (tokens[1] == "binary_big_endian") swap = host_little;
+            else return false; // ascii is not supported
+        }
+        else if (tokens[0] == "element" && tokens.size() >= 3) {
+            PlyElement element;
+            element.name = tokens[1];
+            element.count = (size_t) std::strtoull(tokens[2].c_str(), nullptr, 10);
+            elements.push_back(element);
+        }
+        else if (tokens[0] == "property" && !elements.empty()) {
+            PlyProperty property;
+            if (tokens.size() >= 5 && tokens[1] == "list") {
+                property.count_type = ply_type(tokens[2]);
+                property.type = ply_type(tokens[3]);
+                property.name = tokens[4];
+                if (property.count_type == PlyType::none) return false;
+            }
+            else if (tokens.size() >= 3) {
+                property.type = ply_type(tokens[1]);
+                property.name = tokens[2];
+            }
+            if (property.type == PlyType::none) return false;
+            elements.back().properties.push_back(property);
+        }
+    }
+    if (!header_done) return false;
+
+    for (const PlyElement& element: elements) {
+        if (element.name == "vertex") {
+            size_t stride = element.stride();
+            if (stride == 0 || element.count > (size_t) (end - p) / stride) return false;
+
+            // byte offset and type of the used properties, -1 when missing
+            int offset[8];
+            PlyType type[8];
+            const char* names[8][2] = {
+                { "x", "x" }, { "y", "y" }, { "z", "z" },
+                { "nx", "nx" }, { "ny", "ny" }, { "nz", "nz" },
+                { "u", "s" }, { "v", "t" },
+            };
+            for (int k = 0; k < 8; k++) {
+                offset[k] = -1;
+                type[k] = PlyType::none;
+                size_t o = 0;
+                for (const PlyProperty& property: element.properties) {
+                    if (property.name == names[k][0] || property.name == names[k][1]
+                        || (k >= 6 && property.name == std::string("texture_") + names[k][0])) {
+                        offset[k] = (int) o;
+                        type[k] = property.type;
+                    }
+                    o += ply_size(property.type);
+                }
+            }
+            if (offset[0] < 0 || offset[1] < 0 || offset[2] < 0) return false;
+            bool has_normal = offset[3] >= 0 && offset[4] >= 0 && offset[5] >= 0;
+            bool has_uv = offset[6] >= 0 && offset[7] >= 0;
+
+            data.positions.resize(element.count);
+            if (has_normal) data.normals.resize(element.count);
+            if (has_uv) data.uvs.resize(2 * element.count);
+            const char* rows = p;
+            auto read_vertices = [&](size_t b, size_t e) {
+                for (size_t i = b; i < e; i++) {
+                    const char* row = rows + i * stride;
+                    data.positions[i] = Vec3(ply_read(row + offset[0], type[0], swap),
+                                             ply_read(row + offset[1], type[1], swap),
+                                             ply_read(row + offset[2], type[2], swap));
+                    if (has_normal) {
+                        data.normals[i] = Vec3(ply_read(row + offset[3], type[3], swap),
+                                               ply_read(row + offset[4], type[4], swap),
+                                               ply_read(row + offset[5], type[5], swap));
+                    }
+                    if (has_uv) {
+                        data.uvs[2 * i] = (float) ply_read(row + offset[6], type[6], swap);
+                        data.uvs[2 * i + 1] = (float) ply_read(row + offset[7], type[7], swap);
+                    }
+                }
+            };
+            if (pool && element.count > (1 << 16)) {
+                pool->parallel_for(element.count, 1 << 16, read_vertices);
+            }
+            else {
+                read_vertices(0, element.count);
+            }
+            p += stride * element.count;
+        }
+        else {
+            // faces, and any other element walked row by row
+            if (element.properties.empty()) continue; // rows without data, however many
+            bool faces = element.name == "face";
+            // a face row takes at least a byte, the header's count alone is not trusted
+            if (faces) data.indices.reserve(3 * std::min(element.count, (size_t) (end - p)));
+            for (size_t row = 0; row < element.count; row++) {
+                for (const PlyProperty& property: element.properties) {
+                    if (property.count_type == PlyType::none) {
+                        if ((size_t) (end - p) < ply_size(property.type)) return false;
+                        p += ply_size(property.type);
+                        continue;
+                    }
+                    size_t count_size = ply_size(property.count_type);
+                    if ((size_t) (end - p) < count_size) return false;
+                    // negative or huge counts are rejected before the conversion
+                    double list_count = ply_read(p, property.count_type, swap);
+                    if (!(list_count >= 0 && list_count <= (double) (end - p))) return false;
+                    size_t count = (size_t) list_count;
+                    p += count_size;
+                    size_t index_size = ply_size(property.type);
+                    if (count > (size_t) (end - p) / index_size) return false;
+                    if (faces && (property.name == "vertex_indices" || property.name == "vertex_index")) {
+                        for (size_t k = 2; k < count; k++) {
+                            data.indices.push_back((uint32_t) ply_read(p, property.type, swap));
+                            data.indices.push_back((uint32_t) ply_read(p + (k - 1) * index_size, property.type, swap));
+                            data.indices.push_back((uint32_t) ply_read(p + k * index_size, property.type, swap));
+                        }
+                    }
+                    p += count * index_size;
+                }
+            }
+        }
+    }
+
+    for (uint32_t index: data.indices) {
+        if (index >= data.positions.size()) return false;
+    }
+    return true;
+}
+
+
+// Loads .obj or .ply by extension, nullptr if the file can't be read or parsed
+inline std::shared_ptr<Mesh> load_mesh(const char* path, std::shared_ptr<Material> material,
+                                       const BVHBuildOptions& options = BVHBuildOptions())
+{
+    auto t0 = std::chrono::high_resolution_clock::now();
+
+    MappedFile file;
+    if (!file.open(path) || file.data() == nullptr) {
+        std::cout << "could not open mesh: " << path << std::endl;
+        return nullptr;
+    }
+
+    std::string extension = std::filesystem::path(path).extension().string();
+    for (char& c: extension) c = (char) std::tolower((unsigned char) c);
+
+    MeshData data;
+    bool ok = false;
+    if (extension == ".obj") ok = load_obj(file, data, options.pool);
+    else if (extension == ".ply") ok = load_ply(file, data, options.pool);
+    if (!ok || data.indices.empty()) {
+        std::cout << "could not load mesh: " << path << std::endl;
+        return nullptr;
+    }
+    file.close();
+
+    auto t1 = std::chrono::high_resolution_clock::now();
+    auto mesh = std::make_shared<Mesh>(std::move(data.positions), std::move(data.indices), material,
+                                       std::move(data.normals), std::move(data.uvs), options);
+    auto t2 = std::chrono::high_resolution_clock::now();
+
+    std::cout << "mesh " << path << ": " << mesh->triangle_count() << " triangles"
+              << ", parse: " << std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count() << "ms"
+              << ", bvh: " << std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() << "ms" << std::endl;
+    return mesh;
+}
+
+#endif /* mesh_loader_h */
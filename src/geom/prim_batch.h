@@ -0,0 +1,150 @@
+#ifndef prim_batch_h
+#define prim_batch_h
+
+#include <cstdint>
+#include "../ray.h"
+#include "../math/interval.h"
+#include "../math/double4.h"
+#include "sphere.h"
+#include "quad.h"
+
+// Spheres and quads of a BVH leaf packed in SoA form and intersected in one SIMD pass.
+// intersect() returns a bit mask of the hit lanes and their distances, the caller keeps the nearest
+// and has the primitive finish the Hit if it stays the closest. Same math as the scalar tests, in double precision.
+// Unused lanes hold a primitive that can't be hit.
+
+#define PRIM_BATCH_WIDTH 4
+
+enum PrimBatchKind: uint8_t {
+    PrimBatchKind_None = 0,
+    PrimBatchKind_Sphere,
+    PrimBatchKind_Quad,
+};
+
+// Spheres, and plain quads (not Triangle or Disk, their interior tests differ)
+inline PrimBatchKind prim_batch_kind(const Hittable* object) {
+    if (object->type == HittableType_Sphere) return PrimBatchKind_Sphere;
+    if (object->type == HittableType_Quad && static_cast<const Quad*>(object)->is_parallelogram()) return PrimBatchKind_Quad;
+    return PrimBatchKind_None;
+}
+
+
+// Sphere::distance on four spheres with centers at the ray's time, lanes with a NaN center never hit.
+// Returns the mask of hit lanes, t is the nearest root within limits of each.
+inline int sphere_distance4(const Ray& ray, const Interval& limits,
+                            const Double4& cx, const Double4& cy, const Double4& cz, const Double4& r2, double t[4])
+{
+    const Double4 lx = cx - Double4(ray.origin().X());
+    const Double4 ly = cy - Double4(ray.origin().Y());
+    const Double4 lz = cz - Double4(ray.origin().Z());
+    const Double4 tca = lx * Double4(ray.dir().X()) + ly * Double4(ray.dir().Y()) + lz * Double4(ray.dir().Z());
+    const Double4 d2 = lx * lx + ly * ly + lz * lz - tca * tca;
+    const int inside = d2 <= r2;
+    if (!inside) return 0;
+
+    const Double4 thc = sqrt(r2 - d2);
+    const Double4 t0 = tca - thc;
+    const Double4 t1 = tca + thc;
+    const Double4 tmin(limits.min), tmax(limits.max);
+    const int near_ok = (tmin < t0) & (t0 < tmax);
+    const int far_ok = (tmin < t1) & (t1 < tmax);
+
+    double near_t[4], far_t[4];
+    t0.store(near_t);
+    t1.store(far_t);
+    for (int lane = 0; lane < 4; lane++) {
+        t[lane] = (near_ok >> lane) & 1 ? near_t[lane] : far_t[lane];
+    }
+    return inside & (near_ok | far_ok);
+}
+
+
+struct alignas(32) SphereBatch {
+    double cx[4], cy[4], cz[4];
+    double vx[4], vy[4], vz[4]; // velocity of moving spheres
+    double r2[4];
+
+    SphereBatch() {
+        for (int lane = 0; lane < 4; lane++) {
+            cx[lane] = cy[lane] = cz[lane] = 0;
+            vx[lane] = vy[lane] = vz[lane] = 0;
+            r2[lane] = -1; // d2 >= 0, never inside
+        }
+    }
+
+    void set(int lane, const Sphere& sphere) {
+        cx[lane] = sphere.center.X(); cy[lane] = sphere.center.Y(); cz[lane] = sphere.center.Z();
+        vx[lane] = sphere.velocity.X(); vy[lane] = sphere.velocity.Y(); vz[lane] = sphere.velocity.Z();
+        r2[lane] = sphere.r * sphere.r;
+    }
+
+    // Sphere::distance on four spheres
+    int intersect(const Ray& ray, const Interval& limits, double t[4]) const {
+        const Double4 time(ray.time());
+        return sphere_distance4(ray, limits,
+                                Double4::load(cx) + Double4::load(vx) * time,
+                                Double4::load(cy) + Double4::load(vy) * time,
+                                Double4::load(cz) + Double4::load(vz) * time,
+                                Double4::load(r2), t);
+    }
+};
+
+
+struct alignas(32) QuadBatch {
+    double qx[4], qy[4], qz[4];
+    double ux[4], uy[4], uz[4];
+    double vx[4], vy[4], vz[4];
+    double wx[4], wy[4], wz[4];
+    double nx[4], ny[4], nz[4];
+    double d[4];
+
+    QuadBatch() {
+        double* fields[] = { qx, qy, qz, ux, uy, uz, vx, vy, vz, wx, wy, wz, nx, ny, nz, d };
+        for (double* field: fields) {
+            for (int lane = 0; lane < 4; lane++) field[lane] = 0; // zero normal, parallel to every ray
+        }
+    }
+
+    void set(int lane, const Quad& quad) {
+        qx[lane] = quad.Q.X(); qy[lane] = quad.Q.Y(); qz[lane] = quad.Q.Z();
+        ux[lane] = quad.u.X(); uy[lane] = quad.u.Y(); uz[lane] = quad.u.Z();
+        vx[lane] = quad.v.X(); vy[lane] = quad.v.Y(); vz[lane] = quad.v.Z();
+        wx[lane] = quad.w.X(); wy[lane] = quad.w.Y(); wz[lane] = quad.w.Z();
+        nx[lane] = quad.normal.X(); ny[lane] = quad.normal.Y(); nz[lane] = quad.normal.Z();
+        d[lane] = quad.D;
+    }
+
+    // Quad::intersect on four quads
+    int intersect(const Ray& ray, const Interval& limits, double t[4]) const {
+        const Double4 ox(ray.origin().X()), oy(ray.origin().Y()), oz(ray.origin().Z());
+        const Double4 dx(ray.dir().X()), dy(ray.dir().Y()), dz(ray.dir().Z());
+        const Double4 n_x = Double4::load(nx), n_y = Double4::load(ny), n_z = Double4::load(nz);
+
+        const Double4 nd = n_x * dx + n_y * dy + n_z * dz;
+        const int facing = Double4(1e-8) <= abs(nd);
+        if (!facing) return 0;
+
+        const Double4 dist = (Double4::load(d) - (n_x * ox + n_y * oy + n_z * oz)) / nd;
+        const int in_limits = (Double4(limits.min) <= dist) & (dist <= Double4(limits.max));
+        int mask = facing & in_limits;
+        if (!mask) return 0;
+
+        const Double4 px = ox + dx * dist - Double4::load(qx);
+        const Double4 py = oy + dy * dist - Double4::load(qy);
+        const Double4 pz = oz + dz * dist - Double4::load(qz);
+        const Double4 u_x = Double4::load(ux), u_y = Double4::load(uy), u_z = Double4::load(uz);
+        const Double4 v_x = Double4::load(vx), v_y = Double4::load(vy), v_z = Double4::load(vz);
+        const Double4 w_x = Double4::load(wx), w_y = Double4::load(wy), w_z = Double4::load(wz);
+
+        // a = w . (qp x v), b = w . (u x qp)
+        const Double4 a = w_x * (py * v_z - pz * v_y) + w_y * (pz * v_x - px * v_z) + w_z * (px * v_y - py * v_x);
+        const Double4 b = w_x * (u_y * pz - u_z * py) + w_y * (u_z * px - u_x * pz) + w_z * (u_x * py - u_y * px);
+        const Double4 zero(0.0), one(1.0);
+        mask &= (zero <= a) & (a <= one) & (zero <= b) & (b <= one);
+
+        dist.store(t);
+        return mask;
+    }
+};
+
+#endif /* prim_batch_h */
@@ -3,6 +3,7 @@
 
 #include "hittable.h"
 #include "hittable_list.h"
+#include "../material_table.h"
 #include "aabb.h"
 #include "../math/vec3.h"
 #include "../math/interval.h"
@@ -27,42 +28,115 @@ class Quad: public Hittable {
     
     AABB bounding_box() const { return bbox; }
     
+    void bind_material(MaterialTable& table) { material.bind(table); }
+    
+    uint32_t material_id() const { return material.id; }
+    
     bool hit(const Ray &ray, const Interval &limits, Hit &hit) const {
-        auto nd = dot(normal, ray.dir());
-        if(std::fabs(nd) < 1e-8) return false;
-        auto t = (D - dot(normal, ray.origin())) / nd;
-        if (!limits.contains(t)) return false;
-        
-        auto p_hit = ray.at(t);
-        Vec3 qp = p_hit - Q;
-        auto a = dot(w, cross(qp, v)); // fraction of u length
-        auto b = dot(w, cross(u, qp)); // fraction of v length
-        if(!is_interior(a, b)) return false;
+        double t, a, b;
+        Vec3 p_hit;
+        if (!intersect(ray, limits, t, p_hit, a, b)) return false;
         
         hit.d = t;
         hit.p = p_hit;
         hit.u = a;
         hit.v = b;
-        hit.material = material.get();
+        hit.material = material.id;
+        hit.light = light;
         hit.set_normal(ray, normal);
         
         return true;
     }
     
+    bool occluded(const Ray &ray, const Interval &limits) const {
+        double t, a, b;
+        Vec3 p_hit;
+        return intersect(ray, limits, t, p_hit, a, b);
+    }
+    
+    // Distance only, finish_hit computes the rest once this is the closest hit
+    bool hit_distance(const Ray &ray, const Interval &limits, double& d) const {
+        double a, b;
+        Vec3 p_hit;
+        return intersect(ray, limits, d, p_hit, a, b);
+    }
+    
+    // Surface attributes at hit.d, the plane coordinates are recomputed
+    void finish_hit(const Ray &ray, Hit &hit) const {
+        hit.p = ray.at(hit.d);
+        Vec3 qp = hit.p - Q;
+        hit.u = dot(w, cross(qp, v));
+        hit.v = dot(w, cross(u, qp));
+        hit.material = material.id;
+        hit.light = light;
+        hit.set_normal(ray, normal);
+    }
+    
+    // Distance, point and plane coordinates (fractions of u and v) of the hit
+    inline bool intersect(const Ray &ray, const Interval &limits, double& t, Vec3& p_hit, double& a, double& b) const {
+        auto nd = dot(normal, ray.dir());
+        if(std::fabs(nd) < 1e-8) return false;
+        t = (D - dot(normal, ray.origin())) / nd;
+        if (!limits.contains(t)) return false;
+        
+        p_hit = ray.at(t);
+        Vec3 qp = p_hit - Q;
+        a = dot(w, cross(qp, v));
+        b = dot(w, cross(u, qp));
+        return is_interior(a, b);
+    }
+    
     virtual inline bool is_interior(double a, double b) const {
         auto unit_interval = Interval(0, 1);
         return unit_interval.contains(a) && unit_interval.contains(b);
     }
     
-private:
+    // false for the subclasses with their own is_interior
+    bool is_parallelogram() const { return parallelogram; }
+    
+    // Light sampling: a uniform point of the parallelogram at plane coordinates (a, b),
+    // the direction and distance to it from origin and the pdf converted from area to solid angle.
+    // Both sides are lit. None when origin is in the plane.
+    bool sample_toward(const Vec3& origin, double a, double b, Vec3& dir, double& distance, double& pdf) const {
+        Vec3 to_point = Q + a * u + b * v - origin;
+        double d2 = to_point.len_sq();
+        distance = std::sqrt(d2);
+        dir = to_point / distance;
+        double cosine = std::fabs(dot(normal, dir));
+        if (cosine < 1e-8) return false;
+        pdf = d2 / (cosine * area());
+        return true;
+    }
+    
+    // Solid angle pdf of sample_toward for the point p seen from origin
+    double pdf_toward(const Vec3& origin, const Vec3& p) const {
+        Vec3 to_point = p - origin;
+        double d2 = to_point.len_sq();
+        double cosine = std::fabs(dot(normal, to_point)) / std::sqrt(d2);
+        if (cosine < 1e-8) return 0;
+        return d2 / (cosine * area());
+    }
+    
+    double area() const {
+        return cross(u, v).len();
+    }
+    
+    // Index in the scene's LightList, for emissive parallelograms
+    int light = -1;
+    
+protected:
+    friend struct QuadBatch;
+    friend class LightList;
+
     Vec3 Q;
     Vec3 u;
     Vec3 v;
     Vec3 w;
-    std::shared_ptr<Material> material;
+    MaterialRef material;
     AABB bbox;
     Vec3 normal;
     double D;
+    bool parallelogram = true;
     
 };
 
@@ -104,7 +178,9 @@ make_box_2(const Vec3& a, const Vec3& b, shared_ptr<Material> mat)
 class Triangle: public Quad {
 public:
     Triangle(const Vec3& Q, const Vec3& u, const Vec3& v, std::shared_ptr<Material> material)
-    : Quad(Q, u, v, material) { }
+    : Quad(Q, u, v, material) {
+        parallelogram = false;
+    }
     
     inline bool is_interior(double a, double b) const override {
         return a > 0 && b > 0 && a+b<1;
@@ -115,7 +191,14 @@ public:
 class Disk: public Quad {
 public:
     Disk(double r, const Vec3& Q, const Vec3& u, const Vec3& v, std::shared_ptr<Material> material)
-    : Quad(Q, u, v, material), r(r) { }
+    : Quad(Q, u, v, material), r(r)
+    {
+        // centered at Q, the quad bbox only covers the positive quarter
+        auto b1 = AABB(Q - r*u - r*v, Q + r*u + r*v);
+        auto b2 = AABB(Q + r*u - r*v, Q - r*u + r*v);
+        bbox = AABB(b1, b2);
+        parallelogram = false;
+    }
     
     inline bool is_interior(double a, double b) const override {
         return a*a + b*b <= r*r;
@@ -7,6 +7,7 @@
 #include "../math/interval.h"
 #include "aabb.h"
 #include "hittable.h"
+#include "../material_table.h"
 
 // 0 - original RT weekend
 // 1 - scratch-a-pixel geometric (fastest)
@@ -19,10 +20,11 @@ class Sphere: public Hittable { // clang crashes without public inheritance
 public:
     Vec3 center;
     double r;
-    std::shared_ptr<Material> material;
+    MaterialRef material;
     Vec3 center2; // next frame center
     Vec3 velocity;
     AABB bbox;
+    int light = -1; // index in the scene's LightList, for emissive spheres
     
     Sphere(const Vec3& center, double r, std::shared_ptr<Material> material)
     : center(center), r(r), material(material),
@@ -47,6 +49,10 @@ public:
         return bbox;
     }
     
+    void bind_material(MaterialTable& table) {
+        material.bind(table);
+    }
+    
     static void get_uv(const Vec3& p, double& u, double& v) {
         auto phi = std::atan2(-p.Z(), p.X()) + pi;
         auto theta = std::acos(-p.Y());
@@ -54,6 +60,46 @@ public:
         v = theta / pi;
     }
     
+    // Light sampling: a direction from origin, uniform over the cone the sphere covers (PBRT's cone sampling),
+    // the distance to the sphere along it and the solid angle pdf. None from inside the sphere.
+    bool sample_toward(const Vec3& origin, double time, double s1, double s2,
+                       Vec3& dir, double& distance, double& pdf) const {
+        Vec3 to_center = center + velocity * time - origin;
+        double d2 = to_center.len_sq();
+        if (d2 <= r*r) return false;
+        double d = std::sqrt(d2);
+        double sin2_max = r*r / d2;
+        double cos_max = std::sqrt(std::max(0.0, 1 - sin2_max));
+        double one_minus_cos_max = sin2_max / (1 + cos_max); // no cancellation for small, far spheres
+    
+        double cos_theta = 1 - s1 * one_minus_cos_max;
+        double sin2_theta = std::max(0.0, 1 - cos_theta * cos_theta);
+        double sin_theta = std::sqrt(sin2_theta);
+        double phi = 2 * pi * s2;
+    
+        Vec3 w = to_center / d;
+        Vec3 a = std::fabs(w.X()) > 0.9 ? Vec3(0, 1, 0) : Vec3(1, 0, 0);
+        Vec3 u = norm(cross(w, a));
+        Vec3 v = cross(w, u);
+        dir = (sin_theta * std::cos(phi)) * u + (sin_theta * std::sin(phi)) * v + cos_theta * w;
+        distance = d * cos_theta - std::sqrt(std::max(0.0, r*r - d2 * sin2_theta));
+        pdf = 1 / (2 * pi * one_minus_cos_max);
+        return true;
+    }
+    
+    // Solid angle pdf of sample_toward for a direction that hits the sphere
+    double pdf_toward(const Vec3& origin, double time) const {
+        double d2 = (center + velocity * time - origin).len_sq();
+        if (d2 <= r*r) return 0;
+        double sin2_max = r*r / d2;
+        double cos_max = std::sqrt(std::max(0.0, 1 - sin2_max));
+        return (1 + cos_max) / (2 * pi * sin2_max);
+    }
+    
+    double area() const {
+        return 4 * pi * r*r;
+    }
+    
 #if HIT_IMPL == 1
     
     bool hit(const Ray& ray, const Interval& limits, Hit& hit) const {
@@ -62,10 +108,35 @@ public:
 
     }
     
-    // Geometric solution
-    inline bool intersect(const Ray &ray, Interval limits, Hit& hit) const
-    {
+    bool occluded(const Ray& ray, const Interval& limits) const {
+        double d;
+        return hit_distance(ray, limits, d);
+    }
+    
+    // Distance only, finish_hit computes the rest once this is the closest hit
+    bool hit_distance(const Ray& ray, const Interval& limits, double& d) const {
+        return distance(ray, limits, center + velocity * ray.time(), d);
+    }
+    
+    // Surface attributes at hit.d
+    void finish_hit(const Ray& ray, Hit& hit) const {
         Vec3 center_dt = center + velocity * ray.time();
+        hit.p = ray.at(hit.d);
+        Vec3 normal = (hit.p - center_dt) / r;
+        hit.set_normal(ray, normal);
+        if (material.needs_uv) {
+            get_uv(hit.n, hit.u, hit.v);
+        }
+        else {
+            hit.u = hit.v = 0;
+        }
+        hit.material = material.id;
+        hit.light = light;
+    }
+    
+    // Geometric solution, the nearest root within limits
+    inline bool distance(const Ray &ray, const Interval& limits, const Vec3& center_dt, double& d) const
+    {
         double t0, t1; // solutions for t if the ray intersects
         Vec3 L = center_dt - ray.origin();
         double tca = dot(L, ray.dir());
@@ -75,18 +146,22 @@ public:
         double thc = sqrt(r*r - d2);
         t0 = tca - thc;
         t1 = tca + thc;
-        double d = t0;
+        d = t0;
         if (!limits.surrounds(t0)) {
             d = t1;
             if (!limits.surrounds(d))
                 return false;
         }
+        return true;
+    }
+    
+    inline bool intersect(const Ray &ray, Interval limits, Hit& hit) const
+    {
+        double d;
+        if (!hit_distance(ray, limits, d))
+            return false;
         hit.d = d;
-        hit.p = ray.at(hit.d);
-        Vec3 normal = (hit.p - center_dt) / r;
-        hit.set_normal(ray, normal);
-        get_uv(hit.n, hit.u, hit.v);
-        hit.material = material.get();
+        finish_hit(ray, hit);
         return true;
     }
 #endif
@@ -0,0 +1,227 @@
+#ifndef sphere_set_h
+#define sphere_set_h
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include "hittable.h"
+#include "sphere.h"
+#include "bvh_tree.h"
+#include "wide_bvh.h"
+#include "prim_batch.h"
+#include "../material_table.h"
+
+// Many spheres in flat arrays with their own bottom level BVH.
+// A sphere is its center and radius (32 bytes) plus a material index into the scene's MaterialTable,
+// moving spheres add a motion delta. A Sphere object with its shared_ptr material, both centers and AABB
+// is several times that, spread over separate allocations.
+// Leaves are runs of 4 sphere packets in SoA form, intersected with the SphereBatch math.
+class SphereSet: public Hittable {
+public:
+    // Unused lanes have a NaN center and never hit
+    struct alignas(32) SpherePacket {
+        double x[4], y[4], z[4];
+        double r[4];
+    };
+
+    struct alignas(32) MotionPacket {
+        double x[4], y[4], z[4];
+    };
+
+    SphereSet(const MaterialTable& materials)
+    : Hittable(HittableType_SphereSet), materials(&materials) { }
+
+    void add(const Vec3& center, double r, uint32_t material) {
+        pending.push_back({ center, Vec3::zero(), r, material });
+    }
+
+    // Moves from center at time 0 to center2 at time 1
+    void add(const Vec3& center, const Vec3& center2, double r, uint32_t material) {
+        pending.push_back({ center, center2 - center, r, material });
+        moving = true;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    // Heap memory held by the set: packets, materials, motion and BVH
+    size_t memory_bytes() const {
+        return packets.capacity() * sizeof(SpherePacket)
+             + material_ids.capacity() * sizeof(uint32_t)
+             + motions.capacity() * sizeof(MotionPacket)
+             + tree.nodes.capacity() * sizeof(LinearBVHNode)
+             + wide_tree.nodes.capacity() * sizeof(WideBVHNode<WIDE_BVH_WIDTH>);
+    }
+
+    // Call once after adding the spheres, before the set is hit or put in a scene.
+    // With options.batch_leaves a leaf holds up to 2 full packets, otherwise leaves are sized as usual.
+    void build(const BVHBuildOptions& options = BVHBuildOptions()) {
+        count = pending.size();
+        std::vector<BVHPrimitive> prims(count);
+        auto make_prims = [this, &prims](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                prims[i] = BVHPrimitive(sphere_box(pending[i]), (uint32_t) i);
+            }
+        };
+        if (options.pool && (int) count >= options.parallel_min_size) {
+            options.pool->parallel_for(count, options.parallel_min_size, make_prims);
+        }
+        else {
+            make_prims(0, count);
+        }
+
+        BVHBuildOptions build_options = options;
+        if (options.batch_leaves) {
+            build_options.leaf_batch_width = 4;
+            build_options.max_leaf_size = std::max(options.max_leaf_size, 8);
+        }
+        tree.build(prims, build_options);
+
+        // each leaf becomes a run of packets, node offset and count are in packets from here on
+        for (LinearBVHNode& node: tree.nodes) {
+            if (!node.is_leaf()) continue;
+            const uint32_t first_packet = (uint32_t) packets.size();
+            for (uint32_t k = 0; k < node.count; k += 4) {
+                add_packet(&tree.indices[node.offset + k], std::min<uint32_t>(4, node.count - k));
+            }
+            node.offset = first_packet;
+            node.count = (uint16_t) (packets.size() - first_packet);
+        }
+        pending = std::vector<SphereInput>();
+        tree.indices = std::vector<uint32_t>();
+
+        use_wide = options.use_wide(count);
+        if (use_wide) {
+            wide_tree.build(tree);
+            tree.nodes = std::vector<LinearBVHNode>(); // only the wide tree is traversed
+        }
+    }
+
+    AABB bounding_box() const {
+        return tree.bbox;
+    }
+
+    bool hit(const Ray& ray, const Interval& limits, Hit& hit) const {
+        uint32_t hit_lane = 0; // packet * 4 + lane
+        auto leaf_hit = [this, &hit_lane](uint32_t first, uint32_t count, const Ray& r, Interval l, Hit& h) {
+            bool found = false;
+            for (uint32_t p = first; p < first + count; p++) {
+                double t[4];
+                int mask = intersect(p, r, l, t);
+                for (int lane = 0; lane < 4; lane++) {
+                    if (((mask >> lane) & 1) && t[lane] < l.max) {
+                        h.d = l.max = t[lane];
+                        hit_lane = 4 * p + lane;
+                        found = true;
+                    }
+                }
+            }
+            return found;
+        };
+        bool found = use_wide ? wide_tree.traverse(ray, limits, hit, leaf_hit)
+                              : tree.traverse(ray, limits, hit, leaf_hit);
+        if (!found) return false;
+
+        // attributes only for the closest sphere
+        const SpherePacket& packet = packets[hit_lane / 4];
+        const int lane = hit_lane % 4;
+        Vec3 center_dt(packet.x[lane], packet.y[lane], packet.z[lane]);
+        if (moving) {
+            const MotionPacket& motion = motions[hit_lane / 4];
+            center_dt = center_dt + Vec3(motion.x[lane], motion.y[lane], motion.z[lane]) * ray.time();
+        }
+        hit.p = ray.at(hit.d);
+        hit.set_normal(ray, (hit.p - center_dt) / packet.r[lane]);
+        hit.material = material_ids[hit_lane];
+        hit.light = -1;
+        if (materials->flags(hit.material) & MaterialFlag_NeedsUV) {
+            Sphere::get_uv(hit.n, hit.u, hit.v);
+        }
+        else {
+            hit.u = hit.v = 0;
+        }
+        return true;
+    }
+
+    bool occluded(const Ray& ray, const Interval& limits) const {
+        auto leaf_occluded = [this](uint32_t first, uint32_t count, const Ray& r, const Interval& l) {
+            for (uint32_t p = first; p < first + count; p++) {
+                double t[4];
+                if (intersect(p, r, l, t)) return true;
+            }
+            return false;
+        };
+        if (use_wide) {
+            return wide_tree.occluded(ray, limits, leaf_occluded);
+        }
+        return tree.occluded(ray, limits, leaf_occluded);
+    }
+
+private:
+    // Input of add(), packed by build()
+    struct SphereInput {
+        Vec3 center;
+        Vec3 motion;
+        double r;
+        uint32_t material;
+    };
+
+    const MaterialTable* materials; // owned by the scene
+    std::vector<SphereInput> pending;
+    std::vector<SpherePacket> packets;
+    std::vector<uint32_t> material_ids; // per lane
+    std::vector<MotionPacket> motions;  // empty when no sphere moves
+    size_t count = 0;
+    bool moving = false;
+    BVHTree tree;
+    WideBVHTree<WIDE_BVH_WIDTH> wide_tree;
+    bool use_wide = false;
+
+    static AABB sphere_box(const SphereInput& s) {
+        Vec3 rv(s.r, s.r, s.r);
+        return AABB(AABB(s.center - rv, s.center + rv),
+                    AABB(s.center + s.motion - rv, s.center + s.motion + rv));
+    }
+
+    void add_packet(const uint32_t* sphere_indices, uint32_t n) {
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        SpherePacket& packet = packets.emplace_back();
+        MotionPacket motion;
+        for (uint32_t lane = 0; lane < 4; lane++) {
+            const bool used = lane < n;
+            const SphereInput* s = used ? &pending[sphere_indices[lane]] : nullptr;
+            packet.x[lane] = used ? s->center.X() : nan;
+            packet.y[lane] = used ? s->center.Y() : nan;
+            packet.z[lane] = used ? s->center.Z() : nan;
+            packet.r[lane] = used ? s->r : 0;
+            motion.x[lane] = used ? s->motion.X() : 0;
+            motion.y[lane] = used ? s->motion.Y() : 0;
+            motion.z[lane] = used ? s->motion.Z() : 0;
+            material_ids.push_back(used ? s->material : 0);
+        }
+        if (moving) {
+            motions.push_back(motion);
+        }
+    }
+
+    // Sphere::distance on the 4 lanes of a packet
+    int intersect(uint32_t p, const Ray& ray, const Interval& limits, double t[4]) const {
+        const SpherePacket& packet = packets[p];
+        const Double4 r = Double4::load(packet.r);
+        Double4 cx = Double4::load(packet.x);
+        Double4 cy = Double4::load(packet.y);
+        Double4 cz = Double4::load(packet.z);
+        if (moving) {
+            const MotionPacket& motion = motions[p];
+            const Double4 time(ray.time());
+            cx = cx + Double4::load(motion.x) * time;
+            cy = cy + Double4::load(motion.y) * time;
+            cz = cz + Double4::load(motion.z) * time;
+        }
+        return sphere_distance4(ray, limits, cx, cy, cz, r * r, t);
+    }
+};
+
+#endif /* sphere_set_h */
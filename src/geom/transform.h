@@ -0,0 +1,78 @@
+#ifndef transform_h
+#define transform_h
+
+#include <memory>
+#include "hittable.h"
+#include "../math/affine3.h"
+
+// Places any hittable with a 3x4 affine transform: rotation, scale and translation in one hop.
+// Keeps the inverse for rays and the inverse transpose for normals.
+class Transform: public Hittable {
+public:
+    Transform(std::shared_ptr<Hittable> object, const Affine3& to_world)
+    : Transform(object, to_world, HittableType_Transform) { }
+
+    AABB bounding_box() const { return bbox; }
+
+    bool hit(const Ray& r, const Interval& limits, Hit& hit) const {
+        double scale;
+        Ray object_r = to_object_ray(r, scale);
+        if (!object->hit(object_r, object_limits(limits, scale), hit))
+            return false;
+        to_world_hit(hit, scale);
+        return true;
+    }
+
+    bool occluded(const Ray& r, const Interval& limits) const {
+        double scale;
+        Ray object_r = to_object_ray(r, scale);
+        return object->occluded(object_r, object_limits(limits, scale));
+    }
+
+    const std::shared_ptr<Hittable>& get_object() const { return object; }
+    const Affine3& get_to_world() const { return to_world; }
+
+protected:
+    std::shared_ptr<Hittable> object;
+    Affine3 to_world;
+    Affine3 to_object;
+    Affine3 normal_to_world; // inverse transpose
+    AABB bbox;
+
+    Transform(std::shared_ptr<Hittable> object, const Affine3& to_world, HittableType type)
+    : Hittable(type), object(object), to_world(to_world),
+      to_object(to_world.inverse()), normal_to_world(to_object.transposed())
+    {
+        AABB box = object->bounding_box();
+        Vec3 min( infinity,  infinity,  infinity);
+        Vec3 max(-infinity, -infinity, -infinity);
+        for (int i = 0; i < 8; i++) {
+            Vec3 corner = to_world.point(Vec3(box.xi.bound(i & 1), box.yi.bound((i >> 1) & 1), box.zi.bound(i >> 2)));
+            for (int c = 0; c < 3; c++) {
+                min.set(c, std::fmin(min[c], corner[c]));
+                max.set(c, std::fmax(max[c], corner[c]));
+            }
+        }
+        bbox = AABB(min, max);
+    }
+
+    // Object space ray with a normalized direction, distances along it are `scale` times the world distances
+    Ray to_object_ray(const Ray& r, double& scale) const {
+        Vec3 dir = to_object.vector(r.dir());
+        scale = dir.len();
+        return Ray(to_object.point(r.origin()), dir / scale, r.time());
+    }
+
+    static Interval object_limits(const Interval& limits, double scale) {
+        return Interval(limits.min * scale, limits.max * scale);
+    }
+
+    // The inverse transpose keeps the normal perpendicular and on the same side of the ray, is_front stays valid
+    void to_world_hit(Hit& hit, double scale) const {
+        hit.d /= scale;
+        hit.p = to_world.point(hit.p);
+        hit.n = norm(normal_to_world.vector(hit.n));
+    }
+};
+
+#endif /* transform_h */
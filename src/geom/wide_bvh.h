@@ -0,0 +1,328 @@
+#ifndef wide_bvh_h
+#define wide_bvh_h
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include "bvh_tree.h"
+
+#if defined __AVX__
+#include <immintrin.h>
+#elif defined __SSE2__ || defined _M_X64
+#include <emmintrin.h>
+#endif
+#if defined _MSC_VER
+#include <intrin.h>
+#endif
+
+// Wide Bounding Volume Hierarchy: one node holds the bounds of up to WIDE_BVH_WIDTH children
+// in SoA form, a ray tests all of them at once with SSE (4 wide) or AVX (8 wide).
+// Other platforms use the same layout with a plain loop.
+// Built by collapsing a binary BVHTree, leaves and primitive order are the same as in the binary tree.
+
+#if defined __AVX2__
+#define WIDE_BVH_WIDTH 8
+#else
+#define WIDE_BVH_WIDTH 4
+#endif
+
+
+template<int W>
+struct alignas(32) WideBVHNode {
+    float bounds[2][3][W]; // min, max
+    uint32_t child[W]; // interior child: node index, leaf child: first primitive
+    uint16_t count[W]; // primitives of a leaf child, 0 for interior children
+    uint8_t num_children;
+};
+
+
+template<int W>
+class WideBVHTree {
+public:
+    std::vector<WideBVHNode<W>> nodes;
+
+    void build(const BVHTree& binary) {
+        nodes.clear();
+        if (binary.nodes.empty()) return;
+
+        if (binary.nodes[0].is_leaf()) {
+            // one leaf, still needs a node to hold its bounds
+            nodes.emplace_back();
+            set_child(nodes[0], 0, binary.nodes[0]);
+            nodes[0].num_children = 1;
+            return;
+        }
+        collapse(binary, 0);
+    }
+
+    // Same contract as BVHTree::traverse. Children are visited near to far,
+    // a child whose entry distance is beyond the closest hit found since it was pushed is skipped.
+    template<class LeafHit>
+    bool traverse(const Ray& ray, Interval limits, Hit& hit, LeafHit&& leaf_hit) const {
+        if (nodes.empty()) return false;
+
+        struct Entry {
+            uint32_t index;
+            uint32_t count; // 0 for nodes, primitive count for leaves
+            float tnear;    // entry distance into the child's box
+        };
+
+        const WideRay wray(ray);
+        const float tmin = near_limit(limits.min);
+
+        bool hit_anything = false;
+        Entry stack[512];
+        int stack_size = 0;
+        stack[stack_size++] = { 0, 0, tmin };
+
+        while (stack_size > 0) {
+            Entry entry = stack[--stack_size];
+            if (entry.tnear > far_limit(limits.max)) continue;
+
+            if (entry.count > 0) {
+                if (leaf_hit(entry.index, entry.count, ray, limits, hit)) {
+                    hit_anything = true;
+                    limits.max = hit.d;
+                }
+                continue;
+            }
+
+            const WideBVHNode<W>& node = nodes[entry.index];
+            float tnear[W];
+            int mask = intersect_children(node, wray, tmin, far_limit(limits.max), tnear);
+            mask &= (1 << node.num_children) - 1;
+
+            // sort the hit children by entry distance
+            int order[W];
+            int n = 0;
+            while (mask) {
+                int lane = lowest_bit(mask);
+                mask &= mask - 1;
+                int k = n++;
+                while (k > 0 && tnear[order[k-1]] > tnear[lane]) {
+                    order[k] = order[k-1];
+                    k--;
+                }
+                order[k] = lane;
+            }
+
+            // farthest first, the nearest child is popped next
+            for (int k = n - 1; k >= 0; k--) {
+                int lane = order[k];
+                stack[stack_size++] = { node.child[lane], node.count[lane], tnear[lane] };
+            }
+        }
+        return hit_anything;
+    }
+
+    // Same contract as BVHTree::occluded, children are visited in lane order
+    template<class LeafOccluded>
+    bool occluded(const Ray& ray, const Interval& limits, LeafOccluded&& leaf_occluded) const {
+        if (nodes.empty()) return false;
+
+        const WideRay wray(ray);
+        const float tmin = near_limit(limits.min);
+        const float tmax = far_limit(limits.max);
+
+        struct Entry {
+            uint32_t index;
+            uint32_t count;
+        };
+        Entry stack[512];
+        int stack_size = 0;
+        stack[stack_size++] = { 0, 0 };
+
+        while (stack_size > 0) {
+            Entry entry = stack[--stack_size];
+
+            if (entry.count > 0) {
+                if (leaf_occluded(entry.index, entry.count, ray, limits)) return true;
+                continue;
+            }
+
+            const WideBVHNode<W>& node = nodes[entry.index];
+            float tnear[W];
+            int mask = intersect_children(node, wray, tmin, tmax, tnear);
+            mask &= (1 << node.num_children) - 1;
+            while (mask) {
+                int lane = lowest_bit(mask);
+                mask &= mask - 1;
+                stack[stack_size++] = { node.child[lane], node.count[lane] };
+            }
+        }
+        return false;
+    }
+
+private:
+
+    // Float copy of the ray's precomputed slab test values.
+    // Float tests use t = (bound - origin) * dir_inv, the multiply-add form loses too much precision in float.
+    // The origin is moved by more than its float rounding error, away from the near bound and toward the far one,
+    // so its conversion to float only ever makes the box longer along the ray. Branch free, it runs per ray.
+    struct WideRay {
+        float origin_near[3]; // subtracted from the entry bound
+        float origin_far[3];  // subtracted from the exit bound
+        float dir_inv[3];
+        int sign[3];
+
+        WideRay(const Ray& ray) {
+            for (int axis = 0; axis < 3; axis++) {
+                const float o = (float) ray.origin()[axis];
+                const float error = std::fabs(o) * std::numeric_limits<float>::epsilon() + std::numeric_limits<float>::min();
+                sign[axis] = ray.sign(axis);
+                const float toward_far = error * (1 - 2 * sign[axis]); // along the ray
+                origin_near[axis] = o + toward_far;
+                origin_far[axis] = o - toward_far;
+                dir_inv[axis] = (float) ray.dir_inv()[axis];
+            }
+        }
+    };
+
+    // The subtraction, the multiplication and dir_inv's conversion each round, the exit distance of a box
+    // is scaled by 1 + 2 gamma(3) (PBRT's robust slab test, rounded up to whole float epsilons) to cover them
+    static constexpr float exit_scale = 1 + 4 * std::numeric_limits<float>::epsilon();
+
+    // Float bounds are rounded outward, the limits are widened so float rounding never culls the closest hit
+    static float near_limit(double tmin) {
+        float f = (float) tmin;
+        return f > tmin ? std::nextafter(f, -std::numeric_limits<float>::infinity()) : f;
+    }
+
+    static float far_limit(double tmax) {
+        return (float) (tmax * (1.0 + 1e-6));
+    }
+
+    static int lowest_bit(int mask) {
+    #if defined _MSC_VER
+        unsigned long index;
+        _BitScanForward(&index, mask);
+        return (int) index;
+    #else
+        return __builtin_ctz(mask);
+    #endif
+    }
+
+    static void set_child(WideBVHNode<W>& node, int lane, const LinearBVHNode& child) {
+        for (int axis = 0; axis < 3; axis++) {
+            node.bounds[0][axis][lane] = child.bounds[0][axis];
+            node.bounds[1][axis][lane] = child.bounds[1][axis];
+        }
+        node.child[lane] = child.offset;
+        node.count[lane] = child.count;
+    }
+
+    // Pulls the largest interior descendants of a binary node up into one wide node
+    uint32_t collapse(const BVHTree& binary, uint32_t binary_index) {
+        uint32_t children[W];
+        int n = 2;
+        children[0] = binary_index + 1;
+        children[1] = binary.nodes[binary_index].offset;
+
+        while (n < W) {
+            int best = -1;
+            double best_area = -1;
+            for (int i = 0; i < n; i++) {
+                const LinearBVHNode& c = binary.nodes[children[i]];
+                if (c.is_leaf()) continue;
+                double area = BVHTree::surface_area(c);
+                if (area > best_area) {
+                    best_area = area;
+                    best = i;
+                }
+            }
+            if (best < 0) break;
+            uint32_t expanded = children[best];
+            children[best] = expanded + 1;
+            children[n++] = binary.nodes[expanded].offset;
+        }
+
+        uint32_t index = (uint32_t) nodes.size();
+        nodes.emplace_back();
+
+        WideBVHNode<W> node;
+        for (int lane = 0; lane < W; lane++) {
+            for (int axis = 0; axis < 3; axis++) {
+                node.bounds[0][axis][lane] = 0;
+                node.bounds[1][axis][lane] = 0;
+            }
+            node.child[lane] = 0;
+            node.count[lane] = 0;
+        }
+        node.num_children = (uint8_t) n;
+
+        for (int lane = 0; lane < n; lane++) {
+            const LinearBVHNode& c = binary.nodes[children[lane]];
+            set_child(node, lane, c);
+            if (!c.is_leaf()) {
+                node.child[lane] = collapse(binary, children[lane]);
+            }
+        }
+        nodes[index] = node;
+        return index;
+    }
+
+    // Slab test of all children, returns a bit mask of the hit children and their entry distances.
+    // The ray direction signs pick the near and far slab rows, no min/max swaps per axis.
+    // Running values are the second max/min operand, so a NaN (ray on a slab plane) keeps them.
+    static int intersect_children(const WideBVHNode<W>& node, const WideRay& ray,
+                                  float tmin, float tmax, float tnear[W])
+    {
+    #if defined __AVX__
+        if constexpr (W == 8) {
+            __m256 t_enter = _mm256_set1_ps(tmin);
+            __m256 t_exit = _mm256_set1_ps(tmax);
+            for (int axis = 0; axis < 3; axis++) {
+                const int sign = ray.sign[axis];
+                __m256 o_near = _mm256_set1_ps(ray.origin_near[axis]);
+                __m256 o_far = _mm256_set1_ps(ray.origin_far[axis]);
+                __m256 inv = _mm256_set1_ps(ray.dir_inv[axis]);
+                __m256 t0 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.bounds[sign][axis]), o_near), inv);
+                __m256 t1 = _mm256_mul_ps(_mm256_sub_ps(_mm256_load_ps(node.bounds[1 - sign][axis]), o_far), inv);
+                t_enter = _mm256_max_ps(t0, t_enter);
+                t_exit = _mm256_min_ps(t1, t_exit);
+            }
+            t_exit = _mm256_mul_ps(t_exit, _mm256_set1_ps(exit_scale));
+            _mm256_storeu_ps(tnear, t_enter);
+            return _mm256_movemask_ps(_mm256_cmp_ps(t_enter, t_exit, _CMP_LE_OQ));
+        }
+    #endif
+    #if defined __AVX__ || defined __SSE2__ || defined _M_X64
+        if constexpr (W == 4) {
+            __m128 t_enter = _mm_set1_ps(tmin);
+            __m128 t_exit = _mm_set1_ps(tmax);
+            for (int axis = 0; axis < 3; axis++) {
+                const int sign = ray.sign[axis];
+                __m128 o_near = _mm_set1_ps(ray.origin_near[axis]);
+                __m128 o_far = _mm_set1_ps(ray.origin_far[axis]);
+                __m128 inv = _mm_set1_ps(ray.dir_inv[axis]);
+                __m128 t0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[sign][axis]), o_near), inv);
+                __m128 t1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.bounds[1 - sign][axis]), o_far), inv);
+                t_enter = _mm_max_ps(t0, t_enter);
+                t_exit = _mm_min_ps(t1, t_exit);
+            }
+            t_exit = _mm_mul_ps(t_exit, _mm_set1_ps(exit_scale));
+            _mm_storeu_ps(tnear, t_enter);
+            return _mm_movemask_ps(_mm_cmple_ps(t_enter, t_exit));
+        }
+    #endif
+        int mask = 0;
+        for (int lane = 0; lane < W; lane++) {
+            float t_enter = tmin;
+            float t_exit = tmax;
+            for (int axis = 0; axis < 3; axis++) {
+                const int sign = ray.sign[axis];
+                float t0 = (node.bounds[sign][axis][lane] - ray.origin_near[axis]) * ray.dir_inv[axis];
+                float t1 = (node.bounds[1 - sign][axis][lane] - ray.origin_far[axis]) * ray.dir_inv[axis];
+                if (t0 > t_enter) t_enter = t0;
+                if (t1 < t_exit) t_exit = t1;
+            }
+            t_exit *= exit_scale;
+            tnear[lane] = t_enter;
+            if (t_enter <= t_exit) mask |= 1 << lane;
+        }
+        return mask;
+    }
+};
+
+#endif /* wide_bvh_h */
@@ -25,6 +25,11 @@ inline void write_color(std::ostream& stream, const Vec3& color) {
     stream << rbyte << ' ' << gbyte << ' ' << bbyte << '\n';
 }
 
+// Rec. 709 weights
+inline double luminance(const Vec3& color) {
+    return 0.2126 * color.X() + 0.7152 * color.Y() + 0.0722 * color.Z();
+}
+
 inline double linear_to_gamma(double linear_value) {
     // inverse gamma 2
     if (linear_value < 0)
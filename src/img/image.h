@@ -56,6 +56,33 @@ public:
         }
     }
     
+    // Only the given region, the rest of raw_img is left as it is
+    void copy_for_output_with_gamma(RawImage& raw_img, double factor, int x, int y, int width, int height) {
+        for (int row = y; row < y + height; row++) {
+            int j = (row * w + x) * pixel_size;
+            for (int i = row * w + x; i < row * w + x + width; i++) {
+                Vec3 p = pixels[i];
+                raw_img.bytes[j++] = (uint8_t) ( linear_to_gamma(p.X() * factor ) * 255);
+                raw_img.bytes[j++] = (uint8_t) ( linear_to_gamma(p.Y() * factor ) * 255);
+                raw_img.bytes[j++] = (uint8_t) ( linear_to_gamma(p.Z() * factor ) * 255);
+            }
+        }
+    }
+    
+    // Only the given region, each pixel averaged over its own sample count
+    void copy_for_output_with_gamma(RawImage& raw_img, const uint32_t* sample_counts, int x, int y, int width, int height) {
+        for (int row = y; row < y + height; row++) {
+            int j = (row * w + x) * pixel_size;
+            for (int i = row * w + x; i < row * w + x + width; i++) {
+                Vec3 p = pixels[i];
+                double factor = sample_counts[i] ? 1.0 / sample_counts[i] : 0;
+                raw_img.bytes[j++] = (uint8_t) ( linear_to_gamma(p.X() * factor ) * 255);
+                raw_img.bytes[j++] = (uint8_t) ( linear_to_gamma(p.Y() * factor ) * 255);
+                raw_img.bytes[j++] = (uint8_t) ( linear_to_gamma(p.Z() * factor ) * 255);
+            }
+        }
+    }
+    
     void zero() {
         for (int i = 0; i < w * h; i++) {
             pixels[i] = Vec3::zero();
@@ -0,0 +1,78 @@
+#ifndef sample_stats_h
+#define sample_stats_h
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include "../math/vec3.h"
+#include "color.h"
+
+// Per pixel sample counts and luminance moments, alongside the Image holding the color sums.
+// Adaptive sampling stops a pixel once the noise of its mean is below a target.
+// Luminance is clamped to the displayable [0,1] first, so a light that is always white has no noise.
+// Not synchronized: a tile's pixels are read and written only by the task rendering it,
+// Tracer copies the pass previews (which read the counts) from that task too.
+class SampleStats {
+public:
+    SampleStats(int w, int h)
+    : w(w), samples(w * h, 0), sum(w * h, 0), sum_sq(w * h, 0), active(w * h, 1) { }
+    
+    inline bool is_active(int i) const { return active[i]; }
+    inline const uint32_t* Samples() const { return samples.data(); }
+    inline uint32_t sample_count(int i) const { return samples[i]; }
+    
+    inline void add(int i, const Vec3& color) {
+        double l = std::min(luminance(color), 1.0);
+        samples[i]++;
+        sum[i] += l;
+        sum_sq[i] += l * l;
+    }
+    
+    // Display (gamma 2) difference between the mean and the mean plus one standard error
+    double error(int i) const {
+        const double n = samples[i];
+        if (n < 2) return infinity;
+        const double mean = sum[i] / n;
+        const double variance = std::max(0.0, (sum_sq[i] - n * mean * mean) / (n - 1));
+        const double std_error = std::sqrt(variance / n);
+        return std::sqrt(std::min(mean + std_error, 1.0)) - std::sqrt(mean);
+    }
+    
+    // Stops the pixels of the region whose error is below target, unless a neighbour's isn't:
+    // a single estimate is unreliable at low sample counts (a pixel that missed a small light so far).
+    // Pixels with fewer than min_samples stay active. Returns the number of active pixels left.
+    int update_region(int x, int y, int width, int height, double target, int min_samples) {
+        std::vector<uint8_t> noisy(width * height);
+        for (int row = 0; row < height; row++) {
+            for (int col = 0; col < width; col++) {
+                const int i = (y + row) * w + x + col;
+                noisy[row * width + col] = active[i] && ((int) samples[i] < min_samples || error(i) > target);
+            }
+        }
+        int active_count = 0;
+        for (int row = 0; row < height; row++) {
+            for (int col = 0; col < width; col++) {
+                bool any_noisy = false;
+                for (int r = std::max(row - 1, 0); r <= std::min(row + 1, height - 1); r++) {
+                    for (int c = std::max(col - 1, 0); c <= std::min(col + 1, width - 1); c++) {
+                        any_noisy |= noisy[r * width + c] != 0;
+                    }
+                }
+                const int i = (y + row) * w + x + col;
+                active[i] = active[i] && any_noisy;
+                active_count += active[i];
+            }
+        }
+        return active_count;
+    }
+    
+private:
+    int w;
+    std::vector<uint32_t> samples;
+    std::vector<double> sum;    // of luminance
+    std::vector<double> sum_sq; // of squared luminance
+    std::vector<uint8_t> active;
+};
+
+#endif /* sample_stats_h */
@@ -7,6 +7,9 @@ class Texture {
 public:
     virtual Vec3 value(double u, double v, const Vec3& p) const = 0;
     virtual ~Texture() = default;
+    
+    // false when value() ignores u and v, hits can skip computing them
+    virtual bool uses_uv() const { return false; }
 };
 
 
@@ -45,6 +48,10 @@ public:
         return is_even ? even->value(u, v, p) : odd->value(u, v, p) ;
     }
     
+    bool uses_uv() const override {
+        return even->uses_uv() || odd->uses_uv();
+    }
+    
 private:
     double one_over_scale;
     std::shared_ptr<Texture> even;
@@ -71,6 +78,8 @@ public:
         return Vec3(color_scale*pixel[0], color_scale*pixel[1], color_scale*pixel[2]);
     }
     
+    bool uses_uv() const override { return true; }
+    
 private:
     RwImage image;
 };
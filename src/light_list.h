@@ -0,0 +1,128 @@
+#ifndef light_list_h
+#define light_list_h
+
+#include <vector>
+#include <algorithm>
+#include "geom/sphere.h"
+#include "geom/quad.h"
+#include "material_table.h"
+#include "img/color.h"
+
+typedef enum {
+    LightType_Sphere,
+    LightType_Quad,
+} LightType;
+
+struct Light {
+    LightType type;
+    const Hittable* shape; // a Sphere or a parallelogram Quad, owned by the scene
+    Material* material;
+    double power;          // emission luminance times area, for picking lights
+};
+
+// A light sample seen from a shading point
+struct LightSample {
+    Vec3 dir;        // unit
+    double distance; // to the point on the light
+    double pdf;      // solid angle, includes the probability of picking the light
+    Vec3 emission;
+};
+
+
+// The emissive spheres and parallelograms of a scene, for next event estimation.
+// Scene::make_bvh collects them, their index goes into each primitive so hits report it.
+// Lights are picked in proportion to their power, a point on them with the shape's sampling.
+class LightList {
+public:
+    int add(Sphere* sphere, const MaterialTable& materials) {
+        Material* material = materials.get(sphere->material.id);
+        double power = luminance(material->visit_emitted(0.5, 0.5, sphere->center)) * sphere->area();
+        return append({ LightType_Sphere, sphere, material, power });
+    }
+
+    int add(Quad* quad, const MaterialTable& materials) {
+        Material* material = materials.get(quad->material_id());
+        double power = luminance(material->visit_emitted(0.5, 0.5, quad->Q + 0.5 * (quad->u + quad->v))) * quad->area();
+        return append({ LightType_Quad, quad, material, power });
+    }
+
+    // After the last add
+    void build() {
+        double total = 0;
+        for (const Light& light: lights) total += light.power;
+        cdf.clear();
+        double sum = 0;
+        for (size_t i = 0; i < lights.size(); i++) {
+            sum += lights[i].power;
+            // uniform when no light is bright at the point the power was taken at (textures)
+            cdf.push_back(total > 0 ? sum / total : (i + 1) / (double) lights.size());
+        }
+    }
+
+    bool empty() const {
+        return lights.empty();
+    }
+
+    size_t size() const {
+        return lights.size();
+    }
+
+    // Picks a light with pick and samples a point on it with (s1, s2) toward origin.
+    // false when the light can't be seen from origin.
+    bool sample(double pick, double s1, double s2, const Vec3& origin, double time, LightSample& sample) const {
+        const size_t index = std::min<size_t>(std::upper_bound(cdf.begin(), cdf.end(), pick) - cdf.begin(), lights.size() - 1);
+        const Light& light = lights[index];
+        double u = 0, v = 0;
+        switch (light.type) {
+            case LightType_Sphere: {
+                const Sphere* sphere = static_cast<const Sphere*>(light.shape);
+                if (!sphere->sample_toward(origin, time, s1, s2, sample.dir, sample.distance, sample.pdf)) return false;
+                if (sphere->material.needs_uv) {
+                    Vec3 center = sphere->center + sphere->velocity * time;
+                    Sphere::get_uv((origin + sample.distance * sample.dir - center) / sphere->r, u, v);
+                }
+                break;
+            }
+            case LightType_Quad: {
+                const Quad* quad = static_cast<const Quad*>(light.shape);
+                if (!quad->sample_toward(origin, s1, s2, sample.dir, sample.distance, sample.pdf)) return false;
+                u = s1;
+                v = s2;
+                break;
+            }
+        }
+        sample.pdf *= probability(index);
+        sample.emission = light.material->visit_emitted(u, v, origin + sample.distance * sample.dir);
+        return true;
+    }
+
+    // Solid angle pdf of sample for the light that hit reports, ray is the one that found it
+    double pdf(const Ray& ray, const Hit& hit) const {
+        const Light& light = lights[hit.light];
+        double pdf = 0;
+        switch (light.type) {
+            case LightType_Sphere:
+                pdf = static_cast<const Sphere*>(light.shape)->pdf_toward(ray.origin(), ray.time());
+                break;
+            case LightType_Quad:
+                pdf = static_cast<const Quad*>(light.shape)->pdf_toward(ray.origin(), hit.p);
+                break;
+        }
+        return pdf * probability(hit.light);
+    }
+
+private:
+    std::vector<Light> lights;
+    std::vector<double> cdf; // normalized running sum of the powers, cdf[i] ends the range of light i
+
+    int append(const Light& light) {
+        lights.push_back(light);
+        return (int) lights.size() - 1;
+    }
+
+    double probability(size_t index) const {
+        return cdf[index] - (index > 0 ? cdf[index - 1] : 0);
+    }
+};
+
+#endif /* light_list_h */
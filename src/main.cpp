@@ -1,11 +1,41 @@
+#include <cstring>
+#include <cstdlib>
 #include "rw.h"
 #include "img/ppm.h"
 #include "img/image.h"
 
 int main(int argc, const char * argv[]) {
     
-    rw_init_scene(1);
+    rw_init_workers(0);
+    
+    if (argc > 2 && std::strcmp(argv[1], "bench") == 0 && std::strcmp(argv[2], "integrators") == 0) {
+        const int samples_per_pixel = argc > 3 ? std::atoi(argv[3]) : 4;
+        for (int scene_id = 1; scene_id <= 9; scene_id++) {
+            rw_init_scene(scene_id);
+            rw_bench_integrators(samples_per_pixel);
+        }
+        rw_shutdown_workers();
+        return 0;
+    }
+    
+    if (argc > 1 && std::strcmp(argv[1], "bench") == 0) {
+        for (int scene_id: { 1, 9 }) {
+            rw_init_scene(scene_id);
+            rw_bench_traversal();
+        }
+        rw_shutdown_workers();
+        return 0;
+    }
+    
+    if (argc > 2 && std::strcmp(argv[1], "mesh") == 0) {
+        rw_set_mesh_path(argv[2]);
+        rw_init_scene(10);
+    }
+    else {
+        rw_init_scene(1);
+    }
     rw_render();
+    rw_shutdown_workers();
     
     // output
     Image* img = rw_get_image();
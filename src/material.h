@@ -1,8 +1,9 @@
 #ifndef material_h
 #define material_h
 
-#include <random>
+#include <cstdint>
 #include "img/texture.h"
+#include "sampler.h"
 
 typedef enum {
     MaterialType_Lambertian,
@@ -12,15 +13,47 @@ typedef enum {
     MaterialType_Isotropic,
 } MaterialType;
 
+// What shading needs from a material, cached per material in the scene's MaterialTable
+typedef enum {
+    MaterialFlag_Emissive = 1, // visit_emitted can be non zero
+    MaterialFlag_Specular = 2, // scatters in one direction (or two), no diffuse lobe
+    MaterialFlag_NeedsUV  = 4, // a texture reads hit.u and hit.v
+} MaterialFlag;
+
+
+// Point in the [-1,1] cube
+inline Vec3 random_in_cube(Sampler& sampler) {
+    double x, y;
+    sampler.get_2d(x, y);
+    return Vec3(2 * x - 1, 2 * y - 1, 2 * sampler.get_1d() - 1);
+}
+
+// Uniform direction
+inline Vec3 random_on_sphere(Sampler& sampler) {
+    double u, v;
+    sampler.get_2d(u, v);
+    double z = 1 - 2 * u;
+    double r = std::sqrt(std::max(0.0, 1 - z * z));
+    double phi = 2 * pi * v;
+    return Vec3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
 
 class Material {
 public:
     MaterialType type;
     int id = 0;
-    Material(MaterialType type): type(type) { }
+    uint8_t flags = 0; // MaterialFlag bits
+    Material(MaterialType type, uint8_t flags = 0): type(type), flags(flags) { }
     
-    bool visit_scatter(const Ray& ray, const Hit& hit, Vec3& attenuation, Ray& scattered);
+    bool visit_scatter(const Ray& ray, const Hit& hit, Vec3& attenuation, Ray& scattered, Sampler& sampler);
     Vec3 visit_emitted(double u, double v, const Vec3& p);
+    
+    // For light sampling: f * cos of scattering toward the unit direction dir, and the solid angle pdf
+    // of scatter choosing dir. The attenuation of scatter is their ratio.
+    // Zero for the specular materials and lights.
+    Vec3 visit_eval(const Ray& ray, const Hit& hit, const Vec3& dir, double& pdf);
+    double visit_pdf(const Ray& ray, const Hit& hit, const Vec3& dir);
 };
 
 
@@ -32,13 +65,13 @@ public:
     : Material(MaterialType_Lambertian), tex(std::make_shared<ColorTexture>(albedo)) { }
     
     LambertianMaterial(shared_ptr<Texture> tex)
-    : Material(MaterialType_Lambertian), tex(tex) { }
+    : Material(MaterialType_Lambertian, tex->uses_uv() ? MaterialFlag_NeedsUV : 0), tex(tex) { }
     
-    bool scatter(const Ray& ray, const Hit& hit, Vec3& attenuation, Ray& scattered) {
+    bool scatter(const Ray& ray, const Hit& hit, Vec3& attenuation, Ray& scattered, Sampler& sampler) {
         // Vec3 scattered_dir = norm(hit.n + Vec3::random(-1, 1));
         // Vec3 scattered_dir = random_vec3_on_hemisphere(hit.n);
         // Vec3 scattered_dir = norm(random_vec3_on_hemisphere(hit.n) + hit.n); // push it towards the normal
-        Vec3 scattered_dir = norm( hit.n + Vec3 { norm_dist(gen), norm_dist(gen), norm_dist(gen) } );
+        Vec3 scattered_dir = norm( hit.n + normal_sigma * normal_vec3(sampler) );
         
         if (scattered_dir.is_near_zero()) {
             scattered_dir = hit.n;
@@ -49,11 +82,37 @@ public:
         return true;
     }
     
+    Vec3 eval(const Ray& ray, const Hit& hit, const Vec3& dir, double& pdf) const {
+        pdf = this->pdf(ray, hit, dir);
+        return tex->value(hit.u, hit.v, hit.p) * pdf;
+    }
+    
+    // Density of the directions of n + s * g, g standard normal, on the unit sphere.
+    // Integrating the normal density along the ray toward dir, with c = cos(n, dir):
+    // (2 pi s^2)^(-3/2) * (s^2 c e^(-1/(2s^2)) + (s^2 + c^2) s sqrt(pi/2) erfc(-c/(s sqrt(2))) e^(-(1-c^2)/(2s^2)))
+    double pdf(const Ray&, const Hit& hit, const Vec3& dir) const {
+        constexpr double s = normal_sigma;
+        constexpr double s2 = s * s;
+        const double c = dot(hit.n, dir);
+        const double norm_factor = 1 / ((2 * pi * s2) * std::sqrt(2 * pi * s2));
+        const double tail = (s2 + c * c) * s * std::sqrt(pi / 2) * std::erfc(-c / (s * std::sqrt(2.0)));
+        return norm_factor * (s2 * c * std::exp(-1 / (2 * s2)) + tail * std::exp(-(1 - c * c) / (2 * s2)));
+    }
+    
 private:
     shared_ptr<Texture> tex;
-    std::random_device random_dev {};
-    std::mt19937 gen { random_dev() };
-    std::normal_distribution<double> norm_dist { 0.0, 0.4 }; // https://en.wikipedia.org/wiki/Normal_distribution
+    // standard deviation of the offset, https://en.wikipedia.org/wiki/Normal_distribution
+    static constexpr double normal_sigma = 0.4;
+    
+    // Three standard normals from two 2D samples (Box-Muller)
+    static Vec3 normal_vec3(Sampler& sampler) {
+        double u1, v1, u2, v2;
+        sampler.get_2d(u1, v1);
+        sampler.get_2d(u2, v2);
+        double r1 = std::sqrt(-2 * std::log(1 - u1));
+        double r2 = std::sqrt(-2 * std::log(1 - u2));
+        return Vec3(r1 * std::cos(2 * pi * v1), r1 * std::sin(2 * pi * v1), r2 * std::cos(2 * pi * v2));
+    }
     
     // True Lambertian Reflection - more rays closer to the normal
     // Imagine a unit sphere above p: centered at p + n, tangent to / touching p
@@ -72,13 +131,13 @@ public:
     Vec3 albedo;
     double fuzz;
     MetalMaterial(const Vec3& albedo, double fuzz):
-        Material(MaterialType_Metal),
+        Material(MaterialType_Metal, MaterialFlag_Specular),
         albedo(albedo),
         fuzz( fuzz <= 1 ? fuzz : 1 ) { }
     
-    bool scatter(const Ray& ray, const Hit& hit, Vec3& attenuation, Ray& scattered) {
+    bool scatter(const Ray& ray, const Hit& hit, Vec3& attenuation, Ray& scattered, Sampler& sampler) {
         Vec3 reflected_dir = norm(reflect(ray.dir(), hit.n));
-        reflected_dir = norm(reflected_dir + fuzz * Vec3::random(-1, 1));
+        reflected_dir = norm(reflected_dir + fuzz * random_in_cube(sampler));
         Ray reflected_ray = Ray( hit.p, reflected_dir, ray.time() );
         attenuation = albedo;
         scattered = reflected_ray;
@@ -92,10 +151,10 @@ class DielectricMaterial: public Material {
 public:
     double refraction_index;
     DielectricMaterial(double refraction_index):
-        Material(MaterialType_Dielectric),
+        Material(MaterialType_Dielectric, MaterialFlag_Specular),
         refraction_index(refraction_index) { }
     
-    bool scatter(const Ray& ray, const Hit& hit, Vec3& attenuation, Ray& scattered) {
+    bool scatter(const Ray& ray, const Hit& hit, Vec3& attenuation, Ray& scattered, Sampler& sampler) {
         attenuation = { 1, 1, 1 };
         double ri = hit.is_front ? ( 1.0 / refraction_index ) : refraction_index;
         
@@ -106,7 +165,7 @@ public:
         Vec3 scattered_dir;
         
         bool cannot_refract = ri * sin_rn > 1.0;
-        if (cannot_refract || reflectance(cos_rn, ri) > rw_random())
+        if (cannot_refract || reflectance(cos_rn, ri) > sampler.get_1d())
             scattered_dir = reflect(unit_dir, hit.n);
         else
             scattered_dir = refract(unit_dir, hit.n, ri);
@@ -128,10 +187,11 @@ public:
 
 class DiffuseLightMaterial: public Material {
 public:
-    DiffuseLightMaterial(shared_ptr<Texture> tex) : Material(MaterialType_Diffuse), tex(tex) {}
-    DiffuseLightMaterial(const Vec3& emit) : Material(MaterialType_Diffuse), tex(make_shared<ColorTexture>(emit)) {}
+    DiffuseLightMaterial(shared_ptr<Texture> tex)
+    : Material(MaterialType_Diffuse, MaterialFlag_Emissive | (tex->uses_uv() ? MaterialFlag_NeedsUV : 0)), tex(tex) {}
+    DiffuseLightMaterial(const Vec3& emit) : Material(MaterialType_Diffuse, MaterialFlag_Emissive), tex(make_shared<ColorTexture>(emit)) {}
 
-    bool scatter(const Ray& ray, const Hit& hit, Vec3& attenuation, Ray& scattered) {
+    bool scatter(const Ray& ray, const Hit& hit, Vec3& attenuation, Ray& scattered, Sampler&) {
         return false;
     }
     
@@ -150,42 +210,51 @@ class IsotropicMaterial : public Material {
         : Material(MaterialType_Isotropic), tex(make_shared<ColorTexture>(albedo)) { }
     
     IsotropicMaterial(shared_ptr<Texture> tex)
-        : Material(MaterialType_Isotropic), tex(tex) { }
+        : Material(MaterialType_Isotropic, tex->uses_uv() ? MaterialFlag_NeedsUV : 0), tex(tex) { }
 
-    bool scatter(const Ray& ray, const Hit& hit, Vec3& attenuation, Ray& scattered)
+    bool scatter(const Ray& ray, const Hit& hit, Vec3& attenuation, Ray& scattered, Sampler& sampler)
     {
-        scattered = Ray(hit.p, random_unit_vector(), ray.time());
+        scattered = Ray(hit.p, random_on_sphere(sampler), ray.time());
         attenuation = tex->value(hit.u, hit.v, hit.p);
         return true;
     }
+    
+    Vec3 eval(const Ray& ray, const Hit& hit, const Vec3& dir, double& pdf) const {
+        pdf = this->pdf(ray, hit, dir);
+        return tex->value(hit.u, hit.v, hit.p) * pdf;
+    }
+    
+    double pdf(const Ray&, const Hit&, const Vec3&) const {
+        return 1 / (4 * pi);
+    }
 
   private:
     shared_ptr<Texture> tex;
 };
 
 
-bool Material::visit_scatter(const Ray& ray, const Hit& hit, Vec3& attenuation, Ray& scattered) {
+bool Material::visit_scatter(const Ray& ray, const Hit& hit, Vec3& attenuation, Ray& scattered, Sampler& sampler) {
     // Using static dispatch instead of inheritance vtable dynamic dispatch
     switch (type) {
         case MaterialType_Lambertian: {
             LambertianMaterial* lm = static_cast<LambertianMaterial*>(this);
-            return lm->scatter(ray, hit, attenuation, scattered);
+            return lm->scatter(ray, hit, attenuation, scattered, sampler);
         }
         case MaterialType_Metal: {
             MetalMaterial* mm = static_cast<MetalMaterial*>(this);
-            return mm->scatter(ray, hit, attenuation, scattered);
+            return mm->scatter(ray, hit, attenuation, scattered, sampler);
         }
         case MaterialType_Dielectric: {
             DielectricMaterial* dm = static_cast<DielectricMaterial*>(this);
-            return dm->scatter(ray, hit, attenuation, scattered);
+            return dm->scatter(ray, hit, attenuation, scattered, sampler);
         }
         case MaterialType_Diffuse: {
             DiffuseLightMaterial* dm = static_cast<DiffuseLightMaterial*>(this);
-            return dm->scatter(ray, hit, attenuation, scattered);
+            return dm->scatter(ray, hit, attenuation, scattered, sampler);
         }
         case MaterialType_Isotropic: {
             IsotropicMaterial* im = static_cast<IsotropicMaterial*>(this);
-            return im->scatter(ray, hit, attenuation, scattered);
+            return im->scatter(ray, hit, attenuation, scattered, sampler);
         }
         default: {
             std::cout << "Unhandled material in: " << __FUNCTION__ << std::endl;
@@ -208,4 +277,27 @@ Vec3 Material::visit_emitted(double u, double v, const Vec3& p) {
     }
 }
 
+Vec3 Material::visit_eval(const Ray& ray, const Hit& hit, const Vec3& dir, double& pdf) {
+    switch (type) {
+        case MaterialType_Lambertian:
+            return static_cast<LambertianMaterial*>(this)->eval(ray, hit, dir, pdf);
+        case MaterialType_Isotropic:
+            return static_cast<IsotropicMaterial*>(this)->eval(ray, hit, dir, pdf);
+        default:
+            pdf = 0;
+            return Vec3::zero();
+    }
+}
+
+double Material::visit_pdf(const Ray& ray, const Hit& hit, const Vec3& dir) {
+    switch (type) {
+        case MaterialType_Lambertian:
+            return static_cast<LambertianMaterial*>(this)->pdf(ray, hit, dir);
+        case MaterialType_Isotropic:
+            return static_cast<IsotropicMaterial*>(this)->pdf(ray, hit, dir);
+        default:
+            return 0;
+    }
+}
+
 #endif /* material_h */
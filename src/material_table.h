@@ -0,0 +1,72 @@
+#ifndef material_table_h
+#define material_table_h
+
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "material.h"
+
+// One contiguous entry per material: hits carry the index, shading reads type and flags
+// without touching the material itself
+struct MaterialEntry {
+    Material* material;
+    MaterialType type;
+    uint8_t flags; // MaterialFlag bits
+};
+
+
+// Scene owned materials. Objects refer to them with a 32 bit index,
+// Scene::make_bvh registers the materials of the objects built with shared_ptrs.
+class MaterialTable {
+public:
+    // Index of the material, added on first use
+    uint32_t add(std::shared_ptr<Material> material) {
+        auto found = indices.find(material.get());
+        if (found != indices.end()) return found->second;
+        uint32_t index = (uint32_t) entries.size();
+        entries.push_back({ material.get(), material->type, material->flags });
+        owners.push_back(material);
+        indices[material.get()] = index;
+        return index;
+    }
+
+    const MaterialEntry& operator[](uint32_t index) const {
+        return entries[index];
+    }
+
+    Material* get(uint32_t index) const {
+        return entries[index].material;
+    }
+
+    uint8_t flags(uint32_t index) const {
+        return entries[index].flags;
+    }
+
+    size_t size() const {
+        return entries.size();
+    }
+
+private:
+    std::vector<MaterialEntry> entries;
+    std::vector<std::shared_ptr<Material>> owners;
+    std::unordered_map<const Material*, uint32_t> indices;
+};
+
+
+// Material of a primitive: owned through a shared_ptr while the scene is built,
+// referred to by its table index once Scene::make_bvh binds it
+struct MaterialRef {
+    std::shared_ptr<Material> material;
+    uint32_t id = 0;
+    bool needs_uv = true;
+
+    MaterialRef(std::shared_ptr<Material> material) : material(material) { }
+
+    void bind(MaterialTable& table) {
+        id = table.add(material);
+        needs_uv = table.flags(id) & MaterialFlag_NeedsUV;
+    }
+};
+
+#endif /* material_table_h */
@@ -0,0 +1,109 @@
+#ifndef affine3_h
+#define affine3_h
+
+#include <cmath>
+#include "vec3.h"
+#include "../util/util.h"
+
+// 3x4 affine transform: a 3x3 linear part and a translation column.
+// Compose with * like matrices, the right hand transform is applied first:
+// Affine3::translate(t) * Affine3::rotate_y(a) rotates, then moves.
+class Affine3 {
+public:
+    double m[3][4];
+
+    Affine3(): m{ {1,0,0,0}, {0,1,0,0}, {0,0,1,0} } { }
+
+    static Affine3 identity() {
+        return Affine3();
+    }
+
+    static Affine3 translate(const Vec3& offset) {
+        Affine3 a;
+        a.m[0][3] = offset.X();
+        a.m[1][3] = offset.Y();
+        a.m[2][3] = offset.Z();
+        return a;
+    }
+
+    static Affine3 scale(const Vec3& s) {
+        Affine3 a;
+        a.m[0][0] = s.X();
+        a.m[1][1] = s.Y();
+        a.m[2][2] = s.Z();
+        return a;
+    }
+
+    // Same rotation as RotateY
+    static Affine3 rotate_y(double angle_deg) {
+        double radians = rad_from_deg(angle_deg);
+        double s = std::sin(radians);
+        double c = std::cos(radians);
+        Affine3 a;
+        a.m[0][0] = c;  a.m[0][2] = s;
+        a.m[2][0] = -s; a.m[2][2] = c;
+        return a;
+    }
+
+    Vec3 point(const Vec3& p) const {
+        return Vec3(m[0][0] * p.X() + m[0][1] * p.Y() + m[0][2] * p.Z() + m[0][3],
+                    m[1][0] * p.X() + m[1][1] * p.Y() + m[1][2] * p.Z() + m[1][3],
+                    m[2][0] * p.X() + m[2][1] * p.Y() + m[2][2] * p.Z() + m[2][3]);
+    }
+
+    Vec3 vector(const Vec3& v) const {
+        return Vec3(m[0][0] * v.X() + m[0][1] * v.Y() + m[0][2] * v.Z(),
+                    m[1][0] * v.X() + m[1][1] * v.Y() + m[1][2] * v.Z(),
+                    m[2][0] * v.X() + m[2][1] * v.Y() + m[2][2] * v.Z());
+    }
+
+    // Transposed linear part, no translation
+    Affine3 transposed() const {
+        Affine3 a;
+        for (int i = 0; i < 3; i++) {
+            for (int j = 0; j < 3; j++) {
+                a.m[i][j] = m[j][i];
+            }
+        }
+        return a;
+    }
+
+    Affine3 inverse() const {
+        // cofactors of the linear part
+        double c00 = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+        double c01 = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+        double c02 = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+        double det = m[0][0] * c00 + m[0][1] * c01 + m[0][2] * c02;
+        double inv_det = 1.0 / det;
+
+        Affine3 a;
+        a.m[0][0] = c00 * inv_det;
+        a.m[1][0] = c01 * inv_det;
+        a.m[2][0] = c02 * inv_det;
+        a.m[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * inv_det;
+        a.m[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * inv_det;
+        a.m[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * inv_det;
+        a.m[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * inv_det;
+        a.m[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * inv_det;
+        a.m[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * inv_det;
+
+        Vec3 t = a.vector(Vec3(m[0][3], m[1][3], m[2][3]));
+        a.m[0][3] = -t.X();
+        a.m[1][3] = -t.Y();
+        a.m[2][3] = -t.Z();
+        return a;
+    }
+};
+
+inline Affine3 operator*(const Affine3& a, const Affine3& b) {
+    Affine3 r;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 4; j++) {
+            r.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j];
+        }
+        r.m[i][3] += a.m[i][3];
+    }
+    return r;
+}
+
+#endif /* affine3_h */
@@ -0,0 +1,90 @@
+#ifndef double4_h
+#define double4_h
+
+#include <cmath>
+
+#if defined __AVX__
+#include <immintrin.h>
+#elif defined __SSE2__ || defined _M_X64
+#include <emmintrin.h>
+#endif
+
+// Four doubles with one AVX register, two SSE2 registers or a plain array elsewhere.
+// Just the operations the batched primitive tests need, comparisons return a 4 bit lane mask.
+struct Double4 {
+#if defined __AVX__
+    __m256d v;
+
+    Double4() { }
+    Double4(__m256d v) : v(v) { }
+    explicit Double4(double x) : v(_mm256_set1_pd(x)) { }
+    static Double4 load(const double* p) { return _mm256_load_pd(p); }
+    void store(double* p) const { _mm256_storeu_pd(p, v); }
+
+    friend Double4 operator+(const Double4& a, const Double4& b) { return _mm256_add_pd(a.v, b.v); }
+    friend Double4 operator-(const Double4& a, const Double4& b) { return _mm256_sub_pd(a.v, b.v); }
+    friend Double4 operator*(const Double4& a, const Double4& b) { return _mm256_mul_pd(a.v, b.v); }
+    friend Double4 operator/(const Double4& a, const Double4& b) { return _mm256_div_pd(a.v, b.v); }
+    friend Double4 sqrt(const Double4& a) { return _mm256_sqrt_pd(a.v); }
+    friend Double4 abs(const Double4& a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a.v); }
+    friend int operator<(const Double4& a, const Double4& b) { return _mm256_movemask_pd(_mm256_cmp_pd(a.v, b.v, _CMP_LT_OQ)); }
+    friend int operator<=(const Double4& a, const Double4& b) { return _mm256_movemask_pd(_mm256_cmp_pd(a.v, b.v, _CMP_LE_OQ)); }
+
+#elif defined __SSE2__ || defined _M_X64
+    __m128d lo, hi;
+
+    Double4() { }
+    Double4(__m128d lo, __m128d hi) : lo(lo), hi(hi) { }
+    explicit Double4(double x) : lo(_mm_set1_pd(x)), hi(lo) { }
+    static Double4 load(const double* p) { return Double4(_mm_load_pd(p), _mm_load_pd(p + 2)); }
+    void store(double* p) const { _mm_storeu_pd(p, lo); _mm_storeu_pd(p + 2, hi); }
+
+    friend Double4 operator+(const Double4& a, const Double4& b) { return Double4(_mm_add_pd(a.lo, b.lo), _mm_add_pd(a.hi, b.hi)); }
+    friend Double4 operator-(const Double4& a, const Double4& b) { return Double4(_mm_sub_pd(a.lo, b.lo), _mm_sub_pd(a.hi, b.hi)); }
+    friend Double4 operator*(const Double4& a, const Double4& b) { return Double4(_mm_mul_pd(a.lo, b.lo), _mm_mul_pd(a.hi, b.hi)); }
+    friend Double4 operator/(const Double4& a, const Double4& b) { return Double4(_mm_div_pd(a.lo, b.lo), _mm_div_pd(a.hi, b.hi)); }
+    friend Double4 sqrt(const Double4& a) { return Double4(_mm_sqrt_pd(a.lo), _mm_sqrt_pd(a.hi)); }
+    friend Double4 abs(const Double4& a) {
+        const __m128d sign = _mm_set1_pd(-0.0);
+        return Double4(_mm_andnot_pd(sign, a.lo), _mm_andnot_pd(sign, a.hi));
+    }
+    friend int operator<(const Double4& a, const Double4& b) {
+        return _mm_movemask_pd(_mm_cmplt_pd(a.lo, b.lo)) | (_mm_movemask_pd(_mm_cmplt_pd(a.hi, b.hi)) << 2);
+    }
+    friend int operator<=(const Double4& a, const Double4& b) {
+        return _mm_movemask_pd(_mm_cmple_pd(a.lo, b.lo)) | (_mm_movemask_pd(_mm_cmple_pd(a.hi, b.hi)) << 2);
+    }
+
+#else
+    double v[4];
+
+    Double4() { }
+    explicit Double4(double x) : v{ x, x, x, x } { }
+    static Double4 load(const double* p) { Double4 r; for (int i = 0; i < 4; i++) r.v[i] = p[i]; return r; }
+    void store(double* p) const { for (int i = 0; i < 4; i++) p[i] = v[i]; }
+
+    template<class Op>
+    static Double4 map(const Double4& a, const Double4& b, Op op) {
+        Double4 r;
+        for (int i = 0; i < 4; i++) r.v[i] = op(a.v[i], b.v[i]);
+        return r;
+    }
+    template<class Op>
+    static int mask(const Double4& a, const Double4& b, Op op) {
+        int m = 0;
+        for (int i = 0; i < 4; i++) m |= op(a.v[i], b.v[i]) ? 1 << i : 0;
+        return m;
+    }
+
+    friend Double4 operator+(const Double4& a, const Double4& b) { return map(a, b, [](double x, double y) { return x + y; }); }
+    friend Double4 operator-(const Double4& a, const Double4& b) { return map(a, b, [](double x, double y) { return x - y; }); }
+    friend Double4 operator*(const Double4& a, const Double4& b) { return map(a, b, [](double x, double y) { return x * y; }); }
+    friend Double4 operator/(const Double4& a, const Double4& b) { return map(a, b, [](double x, double y) { return x / y; }); }
+    friend Double4 sqrt(const Double4& a) { return map(a, a, [](double x, double) { return std::sqrt(x); }); }
+    friend Double4 abs(const Double4& a) { return map(a, a, [](double x, double) { return std::fabs(x); }); }
+    friend int operator<(const Double4& a, const Double4& b) { return mask(a, b, [](double x, double y) { return x < y; }); }
+    friend int operator<=(const Double4& a, const Double4& b) { return mask(a, b, [](double x, double y) { return x <= y; }); }
+#endif
+};
+
+#endif /* double4_h */
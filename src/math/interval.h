@@ -20,6 +20,11 @@ public:
         return max - min;
     }
     
+    // 0 - min, 1 - max
+    double bound(int i) const {
+        return i ? max : min;
+    }
+    
     bool contains(double n) const {
         return min <= n && n <= max;
     }
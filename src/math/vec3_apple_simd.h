@@ -59,6 +59,14 @@ public:
         return Vec3(rw_random(min, max), rw_random(min, max), rw_random(min, max));
     }
     
+    inline static Vec3 random(Rng& rng) {
+        return Vec3(rng.uniform(), rng.uniform(), rng.uniform());
+    }
+    
+    inline static Vec3 random(Rng& rng, double min, double max) {
+        return Vec3(rng.uniform(min, max), rng.uniform(min, max), rng.uniform(min, max));
+    }
+    
     inline static Vec3 zero() {
         return Vec3(0, 0, 0);
     }
@@ -157,6 +165,10 @@ inline static Vec3 random_unit_vector() {
     return norm(Vec3::random(-1, 1));
 }
 
+inline static Vec3 random_unit_vector(Rng& rng) {
+    return norm(Vec3::random(rng, -1, 1));
+}
+
 #endif
 
 #endif /* Vec3_apple_simd_h */
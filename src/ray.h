@@ -7,17 +7,35 @@ class Ray {
 private:
     Vec3 _origin;
     Vec3 _dir;
-    double _time;
+    double _time = 0;
+    
+    // Precomputed once per ray for the BVH slab tests: t = bound * dir_inv - origin_inv
+    Vec3 _dir_inv;
+    Vec3 _origin_inv; // origin * dir_inv
+    int _sign[3];     // 1 when dir is negative on the axis, the near slab is the max bound then
+    
+    void precompute() {
+        _dir_inv = Vec3(1.0 / _dir.X(), 1.0 / _dir.Y(), 1.0 / _dir.Z());
+        _origin_inv = _origin * _dir_inv;
+        _sign[0] = _dir_inv.X() < 0;
+        _sign[1] = _dir_inv.Y() < 0;
+        _sign[2] = _dir_inv.Z() < 0;
+    }
     
 public:
-    Ray(const Vec3& origin, const Vec3& dir): _origin(origin), _dir(norm(dir)) { }
-    Ray(const Vec3& origin, const Vec3& dir, double time): _origin(origin), _dir(norm(dir)), _time(time) { }
+    // dir is expected to be normalized, callers already do it once
+    Ray(const Vec3& origin, const Vec3& dir): _origin(origin), _dir(dir) { precompute(); }
+    Ray(const Vec3& origin, const Vec3& dir, double time): _origin(origin), _dir(dir), _time(time) { precompute(); }
     Ray() { }
     
     const Vec3& origin() const { return _origin; }
     const Vec3& dir() const { return _dir; }
     double time() const { return _time; }
     
+    const Vec3& dir_inv() const { return _dir_inv; }
+    const Vec3& origin_inv() const { return _origin_inv; }
+    int sign(int axis) const { return _sign[axis]; }
+    
     Vec3 at(double d) const {
         return _origin + _dir * d;
     }    
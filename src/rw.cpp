@@ -7,6 +7,7 @@ using std::make_shared;
 
 #include "tracer.h"
 #include "scenes/scenes.h"
+#include "bench.h"
 
 
 // viewport - A projection plane in 3D space. In world space, not view space:
@@ -17,9 +18,11 @@ using std::make_shared;
 
 class State {
 public:
+    std::unique_ptr<WorkStealingPool> pool;
     std::unique_ptr<Tracer> tracer;
     std::unique_ptr<Scene> scene;
     int scene_id = -1;
+    std::string mesh_path;
     
     void (*render_pass_callback)(RawImage&);
     void (*render_progress_callback)(double);
@@ -43,12 +46,34 @@ void rw_set_render_progress_callback(void (*render_progress_callback)(double)) {
     state.render_progress_callback = render_progress_callback;
 }
 
+void rw_set_mesh_path(const char* path) {
+    state.mesh_path = path;
+}
+
+void rw_init_workers(int num_threads) {
+    if (num_threads <= 0) {
+        // hardware_concurrency is 10 for M1 pro
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    state.pool.reset(); // joins the previous workers
+    state.pool = std::make_unique<WorkStealingPool>(num_threads, RWThreadPriority::high);
+}
+
+void rw_shutdown_workers() {
+    state.pool.reset();
+}
+
 void rw_init_scene(int scene_id) {
     
     auto t0 = std::chrono::high_resolution_clock::now();
     
     state.scene_id = scene_id;
-    state.tracer = std::make_unique<Tracer>();
+    if (!state.pool) {
+        rw_init_workers(0);
+    }
+    if (!state.tracer) {
+        state.tracer = std::make_unique<Tracer>();
+    }
     
     double aspect_16_9 = 16.0 / 9.0;
     int screen_w = 600;
@@ -82,20 +107,78 @@ void rw_init_scene(int scene_id) {
         case 9:
             state.scene = init_scene_book_2(screen_w, screen_h);
             break;
+        case 10:
+            state.scene = init_scene_mesh(screen_w, screen_h, state.mesh_path.c_str(), state.pool.get());
+            break;
         default: printf("unknown scene id %d", scene_id); break;
     }
     
+    if (state.scene) {
+        BVHBuildOptions bvh_options;
+        bvh_options.pool = state.pool.get();
+        state.scene->make_bvh(bvh_options);
+    }
+    
     auto t1 = std::chrono::high_resolution_clock::now();
     auto dt = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
     std::cout << "scene " << state.scene_id << ": init: " << dt << "ms" << std::endl;
+    
+    if (state.scene && state.scene->bvh) {
+        std::cout << "scene " << state.scene_id << ": bvh: " << state.scene->bvh->node_count() << " nodes"
+                  << ", sah cost: " << state.scene->bvh->sah_cost() << std::endl;
+    }
 }
 
 void rw_render() {
+    if (!state.pool) {
+        rw_init_workers(0);
+    }
+    
     auto t0 = std::chrono::high_resolution_clock::now();
     
-    state.tracer->render(*state.scene, *state.scene->camera, *state.render_pass_callback, *state.render_progress_callback);
+    state.tracer->render(*state.scene, *state.scene->camera, *state.pool, *state.render_pass_callback, *state.render_progress_callback);
     
     auto t1 = std::chrono::high_resolution_clock::now();
     auto dt = std::chrono::duration_cast<std::chrono::milliseconds>(t1 - t0).count();
     std::cout << "scene " << state.scene_id << ": render: " << dt << "ms" << std::endl;
+    if (state.scene->camera->noise_target > 0) {
+        std::cout << "scene " << state.scene_id << ": adaptive: "
+                  << state.tracer->average_samples_per_pixel << " samples per pixel" << std::endl;
+    }
+}
+
+void rw_set_sample_range(int first_sample, int sample_count) {
+    Camera& camera = *state.scene->camera;
+    camera.first_sample = first_sample;
+    if (sample_count > 0) {
+        camera.samples_per_pixel = sample_count;
+        camera.samples_per_pixel_inv = 1 / (double) sample_count;
+    }
+}
+
+void rw_set_noise_target(double target) {
+    state.scene->camera->noise_target = target;
+}
+
+int rw_occluded(double origin_x, double origin_y, double origin_z,
+                double dir_x, double dir_y, double dir_z, double max_distance) {
+    Ray ray(Vec3(origin_x, origin_y, origin_z), norm(Vec3(dir_x, dir_y, dir_z)));
+    return state.scene->occluded(ray, Interval(state.scene->camera->ray_hit_min, max_distance)) ? 1 : 0;
+}
+
+void rw_bench_traversal() {
+    std::string name = "scene " + std::to_string(state.scene_id);
+    bench_traversal(*state.scene, *state.scene->camera, name.c_str());
+}
+
+void rw_bench_integrators(int samples_per_pixel) {
+    if (!state.pool) {
+        rw_init_workers(0);
+    }
+    std::string name = "scene " + std::to_string(state.scene_id);
+    bench_integrators(*state.scene, *state.scene->camera, *state.tracer, *state.pool, name.c_str(), samples_per_pixel);
+}
+
+void rw_set_wavefront(int enabled) {
+    state.tracer->integrator = enabled ? IntegratorType_Wavefront : IntegratorType_Megakernel;
 }
@@ -4,12 +4,45 @@
 class Image;
 struct RawImage;
 
+// Worker threads are created once and reused by every rw_render call.
+// num_threads <= 0 uses all hardware threads. rw_render starts them lazily if needed.
+// Calling it again replaces the workers, don't call it or rw_shutdown_workers during a render.
+void rw_init_workers(int num_threads);
+void rw_shutdown_workers();
+
+// Scene 10 shows the .obj or .ply mesh at this path, set it before rw_init_scene(10)
+void rw_set_mesh_path(const char* path);
+
 void rw_init_scene(int scene_id);
 void rw_render();
 
+// Renders samples [first_sample, first_sample + sample_count) of each pixel instead of the scene's default,
+// sample_count <= 0 keeps the scene's count. Call after rw_init_scene.
+// Renders are bitwise reproducible, a range rendered separately (or on another machine)
+// takes exactly the same samples as that range of a single render.
+void rw_set_sample_range(int first_sample, int sample_count);
+
+// Adaptive sampling, see Camera::noise_target: pixels stop once their noise is below target
+// (in 0..1 display units, 1/255 is one 8 bit step). 0 turns it off. Call after rw_init_scene.
+void rw_set_noise_target(double target);
+
 void rw_set_render_pass_callback(void (*render_pass_callback)(RawImage&));
 void rw_set_render_progress_callback(void (*render_progress_callback)(double));
 
+// 1 if any geometry of the current scene blocks the segment from origin towards dir
+// (need not be normalized) within max_distance, 0 otherwise. Call after rw_init_scene.
+int rw_occluded(double origin_x, double origin_y, double origin_z,
+                double dir_x, double dir_y, double dir_z, double max_distance);
+
+// Times closest hit queries and BVH box tests on the current scene, prints the results
+void rw_bench_traversal();
+
+// Renders the current scene with both integrators at samples_per_pixel, prints their times
+void rw_bench_integrators(int samples_per_pixel);
+
+// 1 renders with the wavefront integrator, 0 with the default megakernel one (see IntegratorType)
+void rw_set_wavefront(int enabled);
+
 Image* rw_get_image();
 RawImage& rw_get_raw_image();
 
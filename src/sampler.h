@@ -0,0 +1,243 @@
+#ifndef sampler_h
+#define sampler_h
+
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+#include "util/rng.h"
+
+// Where the random numbers of a camera sample come from.
+// Independent is white noise from the Rng. The others spread the samples of a pixel evenly
+// over each 1D and 2D dimension, so noise falls faster with the sample count:
+// Stratified - one jittered sample per cell of a grid, cells in a shuffled order
+// CMJ - correlated multi-jittered (Kensler 2013), stratified in 2D and in both 1D projections
+// Sobol - Owen scrambled Sobol (0,2) sequence (Burley 2020), progressive, any sample count works well
+typedef enum {
+    SamplerType_Independent,
+    SamplerType_Stratified,
+    SamplerType_CMJ,
+    SamplerType_Sobol,
+} SamplerType;
+
+
+// Sample values by (pixel, sample index, dimension). The pixel seeds the scrambling of each dimension,
+// the sample index walks along its pattern. Dimensions are counted from the start of each bounce,
+// every 2D request is its own pattern (padding), so dimensions need no fixed layout.
+// Each render worker has its own, with the worker's Rng for anything that isn't a fixed dimension
+// (rejection loops, ConstantMedium inside hit), keyed the same way.
+class Sampler {
+public:
+    Sampler(SamplerType type, int sample_count, Rng& rng)
+    : type(type), rng(rng)
+    {
+        // a grid close to square, m * n >= sample_count cells
+        count = (uint32_t) std::max(sample_count, 1);
+        grid_m = std::max<uint32_t>(1, (uint32_t) std::sqrt((double) count));
+        grid_n = (count + grid_m - 1) / grid_m;
+    }
+
+    void start_sample(uint32_t pixel, uint32_t sample) {
+        this->pixel = pixel;
+        this->sample = sample;
+        rng.seed_sample(pixel, sample);
+        dimension = 0;
+    }
+
+    // The camera ray is bounce 0
+    void start_bounce(uint32_t bounce) {
+        rng.start_bounce(bounce);
+        dimension = bounce << 16;
+    }
+
+    // Where the numbers of the current sample continue from. The wavefront integrator advances
+    // many paths a stage at a time, each resumes its sample where its previous stage left it.
+    struct Position {
+        uint32_t pixel;
+        uint32_t sample;
+        uint32_t dimension;
+        uint64_t rng_key;
+        uint64_t rng_position;
+    };
+
+    Position position() const {
+        return { pixel, sample, dimension, rng.stream_key(), rng.position() };
+    }
+
+    void resume(const Position& position) {
+        pixel = position.pixel;
+        sample = position.sample;
+        dimension = position.dimension;
+        rng.resume(position.rng_key, position.rng_position);
+    }
+
+    // Same as start_bounce after start_sample of the position's sample
+    void resume_bounce(const Position& position, uint32_t bounce) {
+        pixel = position.pixel;
+        sample = position.sample;
+        rng.resume(position.rng_key, 0);
+        start_bounce(bounce);
+    }
+
+    // [0,1)
+    double get_1d() {
+        switch (type) {
+            case SamplerType_Independent:
+                return rng.uniform();
+            case SamplerType_Stratified:
+            case SamplerType_CMJ: {
+                const uint32_t seed = next_seed();
+                const uint32_t s = permute(sample % count, count, seed ^ pass_seed());
+                return (s + jitter(sample, seed * 0x68bc21ebu)) / count;
+            }
+            case SamplerType_Sobol: {
+                const uint32_t seed = next_seed();
+                const uint32_t index = nested_uniform_scramble(sample, seed);
+                return to_unit(nested_uniform_scramble(sobol_0(index), seed * 0x02e5be93u));
+            }
+        }
+        return rng.uniform();
+    }
+
+    // [0,1)^2
+    void get_2d(double& x, double& y) {
+        switch (type) {
+            case SamplerType_Independent:
+                x = rng.uniform();
+                y = rng.uniform();
+                return;
+            case SamplerType_Stratified: {
+                const uint32_t seed = next_seed();
+                const uint32_t cells = grid_m * grid_n;
+                const uint32_t s = permute(sample % cells, cells, seed ^ pass_seed());
+                x = (s % grid_m + jitter(sample, seed * 0x68bc21ebu)) / grid_m;
+                y = (s / grid_m + jitter(sample, seed * 0x02e5be93u)) / grid_n;
+                return;
+            }
+            case SamplerType_CMJ: {
+                const uint32_t seed = next_seed();
+                const uint32_t cells = grid_m * grid_n;
+                const uint32_t s = permute(sample % cells, cells, (seed * 0x51633e2du) ^ pass_seed());
+                const uint32_t sx = permute(s % grid_m, grid_m, seed * 0xa511e9b3u);
+                const uint32_t sy = permute(s / grid_m, grid_n, seed * 0x63d83595u);
+                const double jx = jitter(sample, seed * 0xa399d265u);
+                const double jy = jitter(sample, seed * 0x711ad6a5u);
+                x = (s % grid_m + (sy + jx) / grid_n) / grid_m;
+                y = (s / grid_m + (sx + jy) / grid_m) / grid_n;
+                return;
+            }
+            case SamplerType_Sobol: {
+                const uint32_t seed = next_seed();
+                const uint32_t index = nested_uniform_scramble(sample, seed);
+                x = to_unit(nested_uniform_scramble(sobol_0(index), seed * 0x02e5be93u));
+                y = to_unit(nested_uniform_scramble(sobol_1(index), seed * 0x68bc21ebu));
+                return;
+            }
+        }
+    }
+
+    SamplerType type;
+    Rng& rng;
+
+private:
+    uint32_t count;          // samples per pixel the stratified patterns are made for
+    uint32_t grid_m, grid_n; // 2D strata
+    uint32_t pixel = 0;
+    uint32_t sample = 0;
+    uint32_t dimension = 0;
+
+    // Scramble seed of the next dimension of this pixel
+    uint32_t next_seed() {
+        return (uint32_t) Rng::mix(((uint64_t) pixel << 32) | dimension++);
+    }
+
+    // Samples beyond the pattern size (first_sample offsets) continue with a new shuffle
+    uint32_t pass_seed() const {
+        return (uint32_t) Rng::mix(sample / count + 1);
+    }
+
+    // [0,1) hash of the sample and a seed, for the jitter within a cell
+    static double jitter(uint32_t sample, uint32_t seed) {
+        return (Rng::mix(((uint64_t) seed << 32) | sample) >> 11) * 0x1.0p-53;
+    }
+
+    static double to_unit(uint32_t x) {
+        return x * 0x1.0p-32;
+    }
+
+    // Random permutation of [0, l) applied to i, Kensler's hash with cycle walking
+    static uint32_t permute(uint32_t i, uint32_t l, uint32_t p) {
+        if (l <= 1) return 0;
+        uint32_t w = l - 1;
+        w |= w >> 1; w |= w >> 2; w |= w >> 4; w |= w >> 8; w |= w >> 16;
+        do {
+            i ^= p; i *= 0xe170893du;
+            i ^= p >> 16;
+            i ^= (i & w) >> 4;
+            i ^= p >> 8; i *= 0x0929eb3fu;
+            i ^= p >> 23;
+            i ^= (i & w) >> 1; i *= 1 | p >> 27;
+            i *= 0x6935fa69u;
+            i ^= (i & w) >> 11; i *= 0x74dcb303u;
+            i ^= (i & w) >> 2; i *= 0x9e501cc3u;
+            i ^= (i & w) >> 2; i *= 0xc860a3dfu;
+            i &= w;
+            i ^= i >> 5;
+        } while (i >= l);
+        return (i + p) % l;
+    }
+
+    static uint32_t reverse_bits(uint32_t x) {
+        x = (x << 16) | (x >> 16);
+        x = ((x & 0x00ff00ffu) << 8) | ((x & 0xff00ff00u) >> 8);
+        x = ((x & 0x0f0f0f0fu) << 4) | ((x & 0xf0f0f0f0u) >> 4);
+        x = ((x & 0x33333333u) << 2) | ((x & 0xccccccccu) >> 2);
+        x = ((x & 0x55555555u) << 1) | ((x & 0xaaaaaaaau) >> 1);
+        return x;
+    }
+
+    // Owen scrambling of the bits of x, as a hash on the reversed bits (Laine-Karras, with Vegdahl's constants)
+    static uint32_t nested_uniform_scramble(uint32_t x, uint32_t seed) {
+        x = reverse_bits(x);
+        x ^= x * 0x3d20adeau;
+        x += seed;
+        x *= (seed >> 16) | 1;
+        x ^= x * 0x05526c56u;
+        x ^= x * 0x53a22864u;
+        return reverse_bits(x);
+    }
+
+    // First two Sobol dimensions, van der Corput and the one from the polynomial x + 1
+    static uint32_t sobol_0(uint32_t index) {
+        return reverse_bits(index);
+    }
+
+    // Scrambled indices use all 32 bits, so the direction numbers are xored a byte at a time
+    static uint32_t sobol_1(uint32_t index) {
+        static const SobolTable table;
+        return table.bytes[0][index & 0xff] ^ table.bytes[1][(index >> 8) & 0xff]
+             ^ table.bytes[2][(index >> 16) & 0xff] ^ table.bytes[3][index >> 24];
+    }
+
+    struct SobolTable {
+        uint32_t bytes[4][256];
+
+        SobolTable() {
+            uint32_t directions[32];
+            directions[0] = 1u << 31;
+            for (int bit = 1; bit < 32; bit++) {
+                directions[bit] = directions[bit - 1] ^ (directions[bit - 1] >> 1);
+            }
+            for (int byte = 0; byte < 4; byte++) {
+                for (uint32_t value = 0; value < 256; value++) {
+                    uint32_t result = 0;
+                    for (int bit = 0; bit < 8; bit++) {
+                        if (value & (1u << bit)) result ^= directions[8 * byte + bit];
+                    }
+                    bytes[byte][value] = result;
+                }
+            }
+        }
+    };
+};
+
+#endif /* sampler_h */
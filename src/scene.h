@@ -6,16 +6,23 @@ using std::shared_ptr;
 using std::vector;
 #include "util/arena.h"
 #include "geom/bvh.h"
+#include "geom/linear_bvh.h"
+#include "geom/finalize.h"
 #include "geom/hittable.h"
+#include "material_table.h"
+#include "light_list.h"
 #include "camera.h"
 
 class Scene {
     
 public:
     vector<shared_ptr<Hittable>> objects;
-    BVH_Node* bvh_root; // 2x speed up, compared to iterating objects array
+    std::unique_ptr<LinearBVH> bvh; // 2x speed up, compared to iterating objects array
     std::unique_ptr<Arena> arena;
     std::unique_ptr<Camera> camera;
+    MaterialTable materials; // Hit::material indexes it
+    LightList lights;        // Hit::light indexes it
+    Hittable* root = nullptr; // the bvh, or the only object, which has its own BVH then
     
     void add(shared_ptr<Hittable> obj) {
         objects.push_back(obj);
@@ -26,13 +33,36 @@ public:
     }
     
     bool hit(const Ray& ray, const Interval& limits, Hit& hit) const {
-        return bvh_root->hit(ray, limits, hit);
+        return root->hit(ray, limits, hit);
     }
     
-    void make_bvh() {
-        // bvh_root = new BVH_Node(objects);
-        auto ptr = arena->allocate<BVH_Node>();
-        bvh_root = new (ptr) BVH_Node(objects);
+    // Any hit query for shadow and visibility rays
+    bool occluded(const Ray& ray, const Interval& limits) const {
+        return root->occluded(ray, limits);
+    }
+    
+    // Finalizes the scene, then builds the BVH over the objects.
+    // Untransformed lists are flattened into the objects, transform chains collapse to one Transform.
+    // Materials go into the material table, hits carry their index.
+    // Emissive spheres and parallelograms go into the light list.
+    // BVHSplitMethod::middle in the options gives the older median split tree,
+    // compare bvh->sah_cost() between builders
+    void make_bvh(const BVHBuildOptions& options = BVHBuildOptions()) {
+        vector<shared_ptr<Hittable>> primitives;
+        for (const auto& object: objects) {
+            append_flattened(primitives, object, options);
+        }
+        objects = std::move(primitives);
+        for (const auto& object: objects) {
+            bind_materials(object.get(), materials);
+        }
+        for (const auto& object: objects) {
+            collect_lights(object.get(), materials, lights);
+        }
+        lights.build();
+        bvh = std::make_unique<LinearBVH>(objects, options);
+        // a single SphereSet or Mesh is hit directly, skipping a one leaf tree on top of its own
+        root = objects.size() == 1 ? objects[0].get() : bvh.get();
     }
     
 };
@@ -17,10 +17,12 @@ std::unique_ptr<Scene> init_scene_bouncing_balls(int screen_w, int screen_h)
     auto material2 = make_shared<LambertianMaterial> ( Vec3(0.4, 0.2, 0.1) );
     auto material3 = make_shared<MetalMaterial> ( Vec3(0.7, 0.6, 0.5), 0.0 );
 
-    scene->add( make_shared<Sphere>( Vec3(0, -1000, 3), 1000, material_ground) );
-    scene->add( make_shared<Sphere>( Vec3(0, 1, 0), 1, material1) );
-    scene->add( make_shared<Sphere>( Vec3(-4, 1, 0), 1, material2) );
-    scene->add( make_shared<Sphere>( Vec3(4, 1, 0), 1, material3) );
+    // all spheres in one compact set, materials by index
+    auto spheres = make_shared<SphereSet>( scene->materials );
+    spheres->add( Vec3(0, -1000, 3), 1000, scene->materials.add(material_ground) );
+    spheres->add( Vec3(0, 1, 0), 1, scene->materials.add(material1) );
+    spheres->add( Vec3(-4, 1, 0), 1, scene->materials.add(material2) );
+    spheres->add( Vec3(4, 1, 0), 1, scene->materials.add(material3) );
     
     for (int a = -11; a < 11; a++)
     {
@@ -35,25 +37,25 @@ std::unique_ptr<Scene> init_scene_bouncing_balls(int screen_w, int screen_h)
                     Vec3 color = Vec3::random() * Vec3::random();
                     auto mat = make_shared<LambertianMaterial>( color );
                     Vec3 center2 = center + Vec3(0, 0.2, 0);
-                    scene->add( make_shared<Sphere>( center, center2, 0.2, mat) );
+                    spheres->add( center, center2, 0.2, scene->materials.add(mat) );
                 }
                 else if (mat_dist < 0.95)
                 {
                     Vec3 color = Vec3::random(0.5, 1);
                     double fuzz = rw_random(0, 0.5);
                     auto mat = make_shared<MetalMaterial>( color, fuzz );
-                    scene->add( make_shared<Sphere>( center, 0.2, mat) );
+                    spheres->add( center, 0.2, scene->materials.add(mat) );
                 }
                 else
                 {
                     auto mat = make_shared<DielectricMaterial> ( 1.5 );
-                    scene->add( make_shared<Sphere>( center, 0.2, mat) );
+                    spheres->add( center, 0.2, scene->materials.add(mat) );
                 }
             }
         }
     }
-    
-    scene->make_bvh();
+    spheres->build();
+    scene->add(spheres);
     
     auto camera = std::make_unique<Camera>(screen_w, screen_h);
     camera->vfov_deg = 20;
@@ -45,8 +45,6 @@ std::unique_ptr<Scene>  init_scene_cornell_box(int screen_w, int screen_h)
     box2 = make_shared<Translate>(box2, Vec3(130,0,65));
     scene->add(box2);
     
-    scene->make_bvh();
-    
     auto camera = std::make_unique<Camera>(screen_w, screen_h);
     camera->vfov_deg = 40;
     camera->focus_dist = 10;
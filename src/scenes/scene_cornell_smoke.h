@@ -47,8 +47,6 @@ std::unique_ptr<Scene> init_scene_cornell_smoke(int screen_w, int screen_h)
     auto smoke_box_2 = make_shared<ConstantMedium>(box2, 0.01, Vec3(1,1,1));
     scene->add(smoke_box_2);
     
-    scene->make_bvh();
-    
     auto camera = std::make_unique<Camera>(screen_w, screen_h);
     camera->vfov_deg = 40;
     camera->focus_dist = 10;
@@ -12,6 +12,9 @@
 #include "../geom/quad.h"
 #include "../geom/hittable_list.h"
 #include "../geom/constant_medium.h"
+#include "../geom/instance.h"
+#include "../geom/mesh.h"
+#include "../geom/sphere_set.h"
 #include "../geom/hit_polymorph.h"
 
 //#endif /* scenes_h */
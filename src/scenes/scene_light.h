@@ -25,8 +25,6 @@ std::unique_ptr<Scene> init_scene_light(int screen_w, int screen_h)
         make_shared<Sphere>(Vec3(0,7,0), 2, diffuse_light)
     );
     
-    scene->make_bvh();
-    
     auto camera = std::make_unique<Camera>(screen_w, screen_h);
     camera->vfov_deg = 20;
     camera->focus_dist = 10;
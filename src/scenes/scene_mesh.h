@@ -0,0 +1,43 @@
+#ifndef scene_mesh_h
+#define scene_mesh_h
+
+#include "scene_includes.h"
+#include "../geom/mesh_loader.h"
+
+// A mesh from an .obj or .ply file on a ground plane, scaled to 2 units and centered
+std::unique_ptr<Scene> init_scene_mesh(int screen_w, int screen_h, const char* path, WorkStealingPool* pool)
+{
+    auto scene = std::make_unique<Scene>();
+    
+    scene->arena = std::make_unique<Arena>(1024);
+    
+    auto material_ground = make_shared<LambertianMaterial>(Vec3(0.5, 0.5, 0.5));
+    scene->add(make_shared<Quad>(Vec3(-50,0,-50), Vec3(100,0,0), Vec3(0,0,100), material_ground));
+    
+    BVHBuildOptions options;
+    options.pool = pool;
+    auto mesh = load_mesh(path, make_shared<LambertianMaterial>(Vec3(0.73, 0.73, 0.73)), options);
+    if (mesh) {
+        AABB box = mesh->bounding_box();
+        double size = std::max(box.xi.size(), std::max(box.yi.size(), box.zi.size()));
+        double scale = 2.0 / size;
+        Vec3 base(box.xi.min + box.xi.size() * 0.5, box.yi.min, box.zi.min + box.zi.size() * 0.5);
+        scene->add(make_shared<Transform>(mesh, Affine3::scale(Vec3(scale, scale, scale)) * Affine3::translate(-base)));
+    }
+    
+    auto camera = std::make_unique<Camera>(screen_w, screen_h);
+    camera->vfov_deg = 40;
+    camera->focus_dist = 1;
+    camera->defocus_angle = 0;
+    camera->samples_per_pixel = 50;
+    camera->max_bounces = 10;
+    camera->background = Vec3(0.70, 0.80, 1.00);
+    camera->setup();
+    camera->look_from_at({ 0, 2, 4 }, { 0, 0.8, 0 });
+    
+    scene->camera = std::move(camera);
+    
+    return scene;
+}
+
+#endif /* scene_mesh_h */
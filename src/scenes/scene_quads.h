@@ -38,8 +38,6 @@ std::unique_ptr<Scene> init_scene_quads(int screen_w, int screen_h)
         make_shared<Disk>( 0.5, Vec3(0.6,-1,0), Vec3(1,0,0), Vec3(0,1,0), lower_teal)
     );
     
-    scene->make_bvh();
-    
     auto camera = std::make_unique<Camera>(screen_w, screen_h);
     camera->vfov_deg = 80;
     camera->focus_dist = 10;
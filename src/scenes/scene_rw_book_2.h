@@ -12,8 +12,9 @@ std::unique_ptr<Scene> init_scene_book_2(int screen_w, int screen_h)
     auto light_material = make_shared<DiffuseLightMaterial>(Vec3(7, 7, 7));
     scene->add(make_shared<Quad>(Vec3(123,554,147), Vec3(300,0,0), Vec3(0,0,265), light_material));
     
-    auto boxes1 = make_shared<HittableList>();
+    // ground boxes: instances of one unit box, scaled to their height
     auto ground_material = make_shared<LambertianMaterial>(Vec3(0.48, 0.83, 0.53));
+    auto unit_box = make_shared<LinearBVH>(make_box(Vec3(0,0,0), Vec3(1,1,1), ground_material));
 
     int boxes_per_side = 20;
     for (int i = 0; i < boxes_per_side; i++) {
@@ -26,10 +27,10 @@ std::unique_ptr<Scene> init_scene_book_2(int screen_w, int screen_h)
             auto y1 = rw_random(1, 101);
             auto z1 = z0 + w;
             
-            boxes1->add(make_box_2(Vec3(x0,y0,z0), Vec3(x1,y1,z1), ground_material));
+            auto to_world = Affine3::translate(Vec3(x0,y0,z0)) * Affine3::scale(Vec3(x1-x0, y1-y0, z1-z0));
+            scene->add(make_shared<Instance>(unit_box, to_world));
         }
     }
-    scene->add(boxes1);
     
     // top right sphere
     auto center1 = Vec3(400, 400, 200);
@@ -77,19 +78,14 @@ std::unique_ptr<Scene> init_scene_book_2(int screen_w, int screen_h)
     scene->add(make_shared<Sphere>(Vec3(220,280,300), 80, make_shared<LambertianMaterial>(perlin_texture)));
 
     // bubbles
-    HittableList boxes2;
+    vector<shared_ptr<Hittable>> boxes2;
     auto white = make_shared<LambertianMaterial>(Vec3(.73, .73, .73));
     int ns = 1000;
     for (int j = 0; j < ns; j++) {
-        boxes2.add(make_shared<Sphere>(Vec3::random(0,165), 10, white));
+        boxes2.push_back(make_shared<Sphere>(Vec3::random(0,165), 10, white));
     }
-    scene->add(make_shared<Translate>(
-        make_shared<RotateY>(make_shared<BVH_Node>(boxes2), 15),
-        Vec3(-100,270,395)
-        )
-    );
-    
-    scene->make_bvh();
+    scene->add(make_shared<Instance>(make_shared<LinearBVH>(boxes2),
+                                     Affine3::translate(Vec3(-100,270,395)) * Affine3::rotate_y(15)));
     
     auto camera = std::make_unique<Camera>(screen_w, screen_h);
     camera->vfov_deg = 40;
@@ -30,8 +30,6 @@ std::unique_ptr<Scene> init_scene_texture(int screen_w, int screen_h)
         make_shared<Sphere>(Vec3(0, 0, 0), 2, make_shared<LambertianMaterial>(texture))
     );
     
-    scene->make_bvh();
-    
     auto camera = std::make_unique<Camera>(screen_w, screen_h);
     camera->vfov_deg = 20;
     camera->focus_dist = 10;
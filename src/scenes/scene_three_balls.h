@@ -28,8 +28,6 @@ std::unique_ptr<Scene> init_scene_3_balls(int screen_w, int screen_h)
     scene->add( right );
     scene->add( ground );
     
-    scene->make_bvh();
-    
     auto camera = std::make_unique<Camera>(screen_w, screen_h);
     camera->vfov_deg = 70;
     camera->focus_dist = 1;
@@ -5,6 +5,7 @@
 #include "scene_cornell_box.h"
 #include "scene_cornell_smoke.h"
 #include "scene_light.h"
+#include "scene_mesh.h"
 #include "scene_perlin_spheres.h"
 #include "scene_quads.h"
 #include "scene_rw_book_2.h"
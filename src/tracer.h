@@ -2,22 +2,51 @@
 #define tracer_h
 
 #include <thread>
-#include <latch>
+#include <mutex>
+#include <atomic>
 #include "math/vec3.h"
 #include "img/image.h"
 #include "scene.h"
 #include "camera.h"
-#include "util/thread_pool.h"
+#include "util/work_stealing_pool.h"
 #include "material.h"
+#include "img/sample_stats.h"
+#include "wavefront.h"
+
+// Counts how many bounces each path took and prints the histogram after a render
+#define PATH_DEPTH_STATS 0
 
 class Tracer {
     
+    struct Tile {
+        int x, y, w, h;
+        std::atomic_int passes_done;
+    };
+    
 public:
     
+    // Tile edge size in pixels. Small tiles keep all cores busy until the end of a render.
+    int tile_size = 32;
+    
+    // Sample passes a tile renders in one go, before it is queued again
+    int passes_per_task = 4;
+    
+    // Each path on its own, or all paths of a tile pass a stage at a time, see IntegratorType
+    IntegratorType integrator = IntegratorType_Megakernel;
+    
+    // Mean samples per pixel of the last render, below camera.samples_per_pixel with adaptive sampling
+    double average_samples_per_pixel = 0;
+    
     // In this version, the multisampling loop is the outer loop
-    // allowing for callbacks when each multisample render pass ends
+    // allowing for callbacks when each multisample render pass ends.
+    // Tiles run their passes on a work stealing pool without a barrier between passes,
+    // a pass ends when the last tile finishes it.
+    // The pool is borrowed, it is shared by all renders.
+    // With camera.noise_target, a tile checks its pixels' noise after each task
+    // and stops early when none is above the target, the passes it skips count as done.
     void render(const Scene& scene,
                 Camera& camera,
+                WorkStealingPool& pool,
                 void (*render_pass_callback)(RawImage&),
                 void (*render_progress_callback)(double)
                 )
@@ -26,81 +55,134 @@ public:
         
         camera.image->zero();
         
-        // hardware_concurrency is 10 for M1 pro
-        const int cores = std::thread::hardware_concurrency();
+        const int tile_cols = (camera.image->W() + tile_size - 1) / tile_size;
+        const int tile_rows = (camera.image->H() + tile_size - 1) / tile_size;
+        const int tile_count = tile_rows * tile_cols;
+        const int samples_per_pixel = camera.samples_per_pixel;
+        const bool adaptive = camera.noise_target > 0;
+        SampleStats stats(camera.image->W(), camera.image->H());
         
-        // 10 x 1 performs the best on M1 pro for 600x337 image size
-        const int tile_rows = cores; // std::floor(std::sqrt(cores));
-        const int tile_cols = 1;     // tile_rows;
+        std::vector<Tile> tiles(tile_count);
+        for (int j = 0; j < tile_rows; j++) {
+            for (int i = 0; i < tile_cols; i++) {
+                Tile& tile = tiles[j * tile_cols + i];
+                tile.x = i * tile_size;
+                tile.y = j * tile_size;
+                tile.w = std::min(tile_size, camera.image->W() - tile.x);
+                tile.h = std::min(tile_size, camera.image->H() - tile.y);
+                tile.passes_done = 0;
+            }
+        }
         
-        const int tile_height = camera.image->H() / tile_rows;
-        const int tile_width  = camera.image->W() / tile_cols;
+        #if PRINT_PROGRESS
+        printf("%d tiles\n", tile_count);
+        #endif
         
-        int tile_id = 0;
+        // number of tiles that finished a pass, per pass
+        std::unique_ptr<std::atomic_int[]> pass_tiles_done(new std::atomic_int[samples_per_pixel]);
+        for (int k = 0; k < samples_per_pixel; k++) {
+            pass_tiles_done[k] = 0;
+        }
         
-        #if PRINT_PROGRESS
-        printf("%d tiles\n", tile_rows*tile_cols);
+        std::mutex pass_callback_mutex;
+        int last_reported_pass = -1;
+        
+        #if PATH_DEPTH_STATS
+        path_depths.reset(new std::atomic_uint64_t[camera.max_bounces + 1]);
+        for (int d = 0; d <= camera.max_bounces; d++) {
+            path_depths[d] = 0;
+        }
         #endif
         
         std::atomic_int progress(0);
-        const int totalProgress = tile_rows * tile_cols * camera.samples_per_pixel;
+        const int totalProgress = tile_count * samples_per_pixel;
         
-        ThreadPool thread_pool(cores, RWThreadPriority::high);
-        
-        // multisampling
-        for (int k = 0; k < camera.samples_per_pixel; k++) {
-            
-            std::latch countdown(tile_rows * tile_cols);
-            
-            for (int j = 0; j < tile_rows; j++) {
-                for (int i = 0; i < tile_cols; i++) {
-                    
-                    int x_start = i * tile_width;
-                    int twidth = tile_width;
-                    if(i >= tile_rows - 1) {
-                        twidth = camera.image->W() - x_start;
-                    }
-                    
-                    int y_start = j * tile_height;
-                    int theight = tile_height;
-                    if(j >= tile_rows - 1) {
-                        theight = camera.image->H() - y_start;
-                    }
-                    
-                    int tid = ++tile_id;
-                    thread_pool.enqueue([this, &scene, &camera, y_start, twidth, theight, tid, &progress, render_progress_callback, totalProgress, &countdown] () {
-                        
-                        this->render_tile(scene, camera, 0, twidth, y_start, theight, tid);
-                        countdown.count_down();
-                        
-                        if (render_progress_callback) {
-                            progress++;
-                            render_progress_callback( ((double) progress) / ((double) totalProgress) );
-                        }
-                    });
+        // callback to notify that one pass is done.
+        // Passes are reported in order, the tile that completes one reports the ones after it
+        // that completed while it waited for an earlier pass.
+        auto finish_pass = [&] (int k) {
+            bool is_pass_done = (++pass_tiles_done[k] == tile_count);
+            if (is_pass_done && render_pass_callback) {
+                std::unique_lock<std::mutex> lock(pass_callback_mutex);
+                while (last_reported_pass + 1 < samples_per_pixel
+                       && pass_tiles_done[last_reported_pass + 1] == tile_count) {
+                    last_reported_pass++;
+                    render_pass_callback(camera.raw_image);
                 }
             }
             
-            countdown.wait();
+            if (render_progress_callback) {
+                render_progress_callback( ((double) ++progress) / ((double) totalProgress) );
+            }
+        };
+        
+        std::function<void(int)> run_tile = [&] (int tile_index) {
+            Tile& tile = tiles[tile_index];
+            const int pass_start = tile.passes_done;
+            const int pass_end = std::min(pass_start + passes_per_task, samples_per_pixel);
             
-            // Images are incomplete without joining all the pool threads because threads do not synchronize their cache with RAM
-            // https://vorbrodt.blog/2019/02/21/memory-barriers-and-thread-synchronization/
+            for (int k = pass_start; k < pass_end; k++) {
+                Sampler sampler(camera.sampler_type, camera.first_sample + samples_per_pixel, thread_rng());
+                if (integrator == IntegratorType_Wavefront) {
+                    this->render_tile_wavefront(scene, camera, tile.x, tile.w, tile.y, tile.h,
+                                                camera.first_sample + k, sampler, stats);
+                }
+                else {
+                    this->render_tile(scene, camera, tile.x, tile.w, tile.y, tile.h, tile_index + 1,
+                                      camera.first_sample + k, sampler, stats);
+                }
+                tile.passes_done = k + 1;
+            }
+            const bool done = pass_end >= samples_per_pixel;
+            bool converged = !done && adaptive
+                && stats.update_region(tile.x, tile.y, tile.w, tile.h, camera.noise_target,
+                                       camera.adaptive_min_samples) == 0;
             
-            // callback outside to notify that one pass is done
+            // The tile's pixels and sample counts are only touched by this task,
+            // its preview is copied here, before its passes count as done.
+            // Other tiles may be a few passes ahead or behind, each pixel is averaged with its own count.
             if (render_pass_callback) {
-                camera.image->copy_for_output_with_gamma(camera.raw_image, 1.0f/((double)(k+1))); // don't divide by zero
-                render_pass_callback(camera.raw_image);
+                std::unique_lock<std::mutex> lock(pass_callback_mutex);
+                camera.image->copy_for_output_with_gamma(camera.raw_image, stats.Samples(),
+                                                         tile.x, tile.y, tile.w, tile.h);
+            }
+            for (int k = pass_start; k < pass_end; k++) {
+                finish_pass(k);
+            }
+            if (converged) {
+                for (int k = pass_end; k < samples_per_pixel; k++) {
+                    finish_pass(k);
+                }
+            }
+            if (done || converged) {
+                return;
             }
+            
+            // continuation goes to the back of this worker's deque, after its other tiles
+            pool.enqueue([&run_tile, tile_index] { run_tile(tile_index); });
+        };
+        
+        // contiguous blocks of tiles per worker, neighbouring tiles hit similar geometry
+        for (int t = 0; t < tile_count; t++) {
+            size_t worker_index = (size_t) t * pool.size() / tile_count;
+            pool.enqueue(worker_index, [&run_tile, t] { run_tile(t); });
         }
         
-        thread_pool.stop();
-        thread_pool.join();
+        pool.wait();
         
-        for(int i = 0; i < camera.image->W() * camera.image->H(); i++) {
+        const int pixel_count = camera.image->W() * camera.image->H();
+        double total_samples = 0;
+        for(int i = 0; i < pixel_count; i++) {
             Vec3& pixel = (*camera.image)[i];
-            pixel *= camera.samples_per_pixel_inv; // average
+            pixel *= 1.0 / stats.sample_count(i); // average
             gamma_correct(pixel);
+            total_samples += stats.sample_count(i);
         }
+        average_samples_per_pixel = total_samples / pixel_count;
+        
+        #if PATH_DEPTH_STATS
+        print_path_depths(camera.max_bounces);
+        #endif
         
         camera.image->copy_for_output(camera.raw_image, 1.0f);
         
@@ -113,18 +195,26 @@ public:
                      Camera& camera,
                      int x_start, int width,
                      int y_start, int height,
-                     int tile_id)
+                     int tile_id,
+                     int sample,
+                     Sampler& sampler,
+                     SampleStats& stats)
     {
         for (int row = y_start; row < y_start + height; row++)
         {
             for (int col = x_start; col < x_start + width; col++)
             {
                 int i = row * camera.image->W() + col;
+                if (!stats.is_active(i)) continue;
                 Vec3& pixel = (*camera.image)[i];
                 
+                // keyed by pixel and sample so the render doesn't depend on scheduling
+                sampler.start_sample(i, sample);
                 Vec3 viewport_point;
-                Ray ray = camera.make_ray(col, row, viewport_point);
-                pixel += ray_color(ray, camera.max_bounces, scene, camera);
+                Ray ray = camera.make_ray(col, row, viewport_point, sampler);
+                Vec3 color = ray_color(ray, scene, camera, sampler);
+                pixel += color;
+                stats.add(i, color);
             }
         }
         #if PRINT_PROGRESS
@@ -132,31 +222,329 @@ public:
         #endif
     }
     
-    Vec3 ray_color(const Ray& ray, int bounce_num, const Scene& scene, Camera& camera)
+    // render_tile with the wavefront integrator: the paths of the pass are generated together,
+    // then each bounce runs its stages over all paths still tracing
+    void render_tile_wavefront(const Scene& scene,
+                               Camera& camera,
+                               int x_start, int width,
+                               int y_start, int height,
+                               int sample,
+                               Sampler& sampler,
+                               SampleStats& stats)
     {
-        if (bounce_num <= 0) {
-            return Vec3(0,0,0);
+        PathBatch& paths = worker_path_batch(width * height);
+        generate_paths(paths, camera, x_start, width, y_start, height, sample, sampler, stats);
+        const size_t path_count = paths.active_count;
+        const bool sample_lights = camera.sample_lights && !scene.lights.empty();
+        
+        for (int bounce = 1; bounce <= camera.max_bounces && paths.active_count > 0; bounce++) {
+            intersect_paths(paths, scene, camera, bounce, sampler);
+            shade_paths(paths, scene, bounce, sampler, sample_lights);
+            trace_shadow_rays(paths, scene, camera, sampler);
+            continue_paths(paths, camera, bounce, sampler);
         }
+        #if PATH_DEPTH_STATS
+        path_depths[camera.max_bounces] += paths.active_count;
+        #endif
         
-        Hit hit;
-        if (!scene.hit(ray, Interval(camera.ray_hit_min, camera.ray_hit_max), hit)) {
-            return camera.background;
-            // double f = 0.5 * (ray.dir().Y() + 1.0);
-            // return ((1-f) * Vec3(1, 1, 1)) + (f * Vec3(0.5, 0.7, 1.0));
+        // accumulate, in the order render_tile adds the samples
+        for (uint32_t path = 0; path < path_count; path++) {
+            const Vec3 color = paths.color(path);
+            const uint32_t i = paths.position[path].pixel;
+            (*camera.image)[i] += color;
+            stats.add(i, color);
         }
+    }
+    
+    // Camera rays of the active pixels, all paths start tracing
+    void generate_paths(PathBatch& paths, Camera& camera, int x_start, int width, int y_start, int height,
+                        int sample, Sampler& sampler, const SampleStats& stats)
+    {
+        uint32_t path = 0;
+        for (int row = y_start; row < y_start + height; row++) {
+            for (int col = x_start; col < x_start + width; col++) {
+                const int i = row * camera.image->W() + col;
+                if (!stats.is_active(i)) continue;
+                sampler.start_sample(i, sample);
+                Vec3 viewport_point;
+                paths.set_ray(path, camera.make_ray(col, row, viewport_point, sampler));
+                paths.set_throughput(path, Vec3(1, 1, 1));
+                paths.set_color(path, Vec3(0, 0, 0));
+                paths.scatter_pdf[path] = 0;
+                paths.position[path] = sampler.position();
+                paths.active[path] = path;
+                path++;
+            }
+        }
+        paths.active_count = path;
+    }
+    
+    // Closest hits of the active paths. Paths that miss take the background and end,
+    // the others are grouped by material type for shading (counting sort).
+    void intersect_paths(PathBatch& paths, const Scene& scene, const Camera& camera, int bounce, Sampler& sampler)
+    {
+        const Interval limits(camera.ray_hit_min, camera.ray_hit_max);
+        size_t type_counts[material_type_count] = {};
+        size_t kept = 0;
+        for (size_t k = 0; k < paths.active_count; k++) {
+            const uint32_t path = paths.active[k];
+            sampler.resume_bounce(paths.position[path], bounce);
+            Hit& hit = paths.hits[path];
+            if (!scene.hit(paths.ray(path), limits, hit)) {
+                paths.set_color(path, paths.color(path) + paths.throughput(path) * camera.background);
+                #if PATH_DEPTH_STATS
+                path_depths[bounce]++;
+                #endif
+                continue;
+            }
+            paths.position[path] = sampler.position(); // media draw numbers in hit
+            paths.active[kept++] = path;
+            type_counts[scene.materials[hit.material].type]++;
+        }
+        paths.active_count = kept;
         
-        Vec3 attenuation;
-        Ray scattered;
-        Vec3 emission_color = hit.material->visit_emitted(hit.u, hit.v, hit.p);
-        if (!hit.material->visit_scatter(ray, hit, attenuation, scattered)) {
-            return emission_color;
+        paths.material_start[0] = 0;
+        for (int type = 0; type < material_type_count; type++) {
+            paths.material_start[type + 1] = paths.material_start[type] + type_counts[type];
+        }
+        size_t next[material_type_count];
+        std::copy(paths.material_start, paths.material_start + material_type_count, next);
+        for (size_t k = 0; k < paths.active_count; k++) {
+            const uint32_t path = paths.active[k];
+            paths.shading[next[scene.materials[paths.hits[path].material].type]++] = path;
+        }
+    }
+    
+    // Emission, scattering and light samples of the hits, one material type after another
+    // so the shading code of a type runs in one stretch. Shadow rays are queued.
+    void shade_paths(PathBatch& paths, const Scene& scene, [[maybe_unused]] int bounce, Sampler& sampler, bool sample_lights)
+    {
+        paths.shadow_count = 0;
+        for (size_t k = 0; k < paths.material_start[material_type_count]; k++) {
+            const uint32_t path = paths.shading[k];
+            const Hit& hit = paths.hits[path];
+            const Ray ray = paths.ray(path);
+            sampler.resume(paths.position[path]);
+            
+            Vec3 color = paths.color(path);
+            Vec3 throughput = paths.throughput(path);
+            Ray scattered;
+            ShadowRay shadow;
+            paths.scattered[path] = shade(ray, hit, scene, sampler, sample_lights,
+                                          color, throughput, paths.scatter_pdf[path], scattered, shadow);
+            paths.set_color(path, color);
+            if (!paths.scattered[path]) {
+                #if PATH_DEPTH_STATS
+                path_depths[bounce]++;
+                #endif
+                continue;
+            }
+            paths.set_throughput(path, throughput);
+            paths.set_ray(path, scattered);
+            paths.position[path] = sampler.position();
+            
+            if (shadow.traced) {
+                const size_t s = paths.shadow_count++;
+                paths.shadow_path[s] = path;
+                paths.shadow_dir_x[s] = shadow.dir.X();
+                paths.shadow_dir_y[s] = shadow.dir.Y();
+                paths.shadow_dir_z[s] = shadow.dir.Z();
+                paths.shadow_distance[s] = shadow.distance;
+                paths.shadow_r[s] = shadow.radiance.X();
+                paths.shadow_g[s] = shadow.radiance.Y();
+                paths.shadow_b[s] = shadow.radiance.Z();
+            }
+        }
+    }
+    
+    // Shadow rays of the bounce, unoccluded ones add their light to the path
+    void trace_shadow_rays(PathBatch& paths, const Scene& scene, const Camera& camera, Sampler& sampler)
+    {
+        for (size_t s = 0; s < paths.shadow_count; s++) {
+            const uint32_t path = paths.shadow_path[s];
+            sampler.resume(paths.position[path]); // media draw numbers
+            ShadowRay shadow;
+            shadow.dir = Vec3(paths.shadow_dir_x[s], paths.shadow_dir_y[s], paths.shadow_dir_z[s]);
+            shadow.distance = paths.shadow_distance[s];
+            if (!occluded(scene, camera, paths.hits[path].p, paths.time[path], shadow)) {
+                paths.set_color(path, paths.color(path) + Vec3(paths.shadow_r[s], paths.shadow_g[s], paths.shadow_b[s]));
+            }
+            paths.position[path] = sampler.position();
+        }
+    }
+    
+    // Russian roulette of the paths that scattered, the survivors stay active in pixel order
+    void continue_paths(PathBatch& paths, const Camera& camera, int bounce, Sampler& sampler)
+    {
+        size_t kept = 0;
+        for (size_t k = 0; k < paths.active_count; k++) {
+            const uint32_t path = paths.active[k];
+            if (!paths.scattered[path]) continue;
+            if (bounce >= camera.roulette_min_bounces) {
+                sampler.resume(paths.position[path]);
+                Vec3 throughput = paths.throughput(path);
+                if (!roulette(throughput, bounce, camera, sampler)) {
+                    #if PATH_DEPTH_STATS
+                    path_depths[bounce]++;
+                    #endif
+                    continue;
+                }
+                paths.set_throughput(path, throughput);
+            }
+            paths.active[kept++] = path;
+        }
+        paths.active_count = kept;
+    }
+    
+    // Iterative path, the throughput carries the attenuation of the bounces so far.
+    // From camera.roulette_min_bounces on, a path continues with a probability of its throughput
+    // and is weighted up by its inverse when it does (Russian roulette), dim paths end early
+    // without bias.
+    // With camera.sample_lights, each diffuse hit also picks a point on a light and sends a shadow ray
+    // toward it (next event estimation). The light is then reached two ways, by that sample and by the
+    // scattered ray hitting it, each is weighted by the power heuristic of the two pdfs (Veach's MIS).
+    Vec3 ray_color(const Ray& camera_ray, const Scene& scene, Camera& camera, Sampler& sampler)
+    {
+        Vec3 color(0,0,0);
+        Vec3 throughput(1,1,1);
+        Ray ray = camera_ray;
+        const Interval limits(camera.ray_hit_min, camera.ray_hit_max);
+        const bool sample_lights = camera.sample_lights && !scene.lights.empty();
+        double scatter_pdf = 0;  // of the ray's direction, 0 when its light hits count in full
+        
+        int bounce = 1; // the camera ray is bounce 0 of the sampler, its hit is the first bounce
+        for (; bounce <= camera.max_bounces; bounce++) {
+            sampler.start_bounce(bounce);
+            
+            Hit hit;
+            if (!scene.hit(ray, limits, hit)) {
+                color += throughput * camera.background;
+                // double f = 0.5 * (ray.dir().Y() + 1.0);
+                // return ((1-f) * Vec3(1, 1, 1)) + (f * Vec3(0.5, 0.7, 1.0));
+                break;
+            }
+            
+            Ray scattered;
+            ShadowRay shadow;
+            if (!shade(ray, hit, scene, sampler, sample_lights, color, throughput, scatter_pdf, scattered, shadow)) {
+                break;
+            }
+            if (shadow.traced && !occluded(scene, camera, hit.p, ray.time(), shadow)) {
+                color += shadow.radiance;
+            }
+            if (!roulette(throughput, bounce, camera, sampler)) {
+                break;
+            }
+            ray = scattered;
         }
         
-        Vec3 bounced_color = ray_color(scattered, bounce_num-1, scene, camera);
-        Vec3 scatter_color = attenuation * bounced_color;
+        #if PATH_DEPTH_STATS
+        path_depths[std::min(bounce, camera.max_bounces)]++;
+        #endif
+        return color;
+    }
+    
+    // A shadow ray from a hit point toward a point sampled on a light,
+    // radiance is what the path gathers when nothing blocks it
+    struct ShadowRay {
+        bool traced = false;
+        Vec3 dir;
+        double distance;
+        Vec3 radiance;
+    };
+    
+    // One bounce of a path at hit: adds the emission, scatters and, with sample_lights,
+    // picks a light point for the shadow ray the caller traces (next event estimation).
+    // scatter_pdf is that of the incoming ray on the way in, of scattered on the way out.
+    // false when the path ends at hit.
+    bool shade(const Ray& ray, const Hit& hit, const Scene& scene, Sampler& sampler, bool sample_lights,
+               Vec3& color, Vec3& throughput, double& scatter_pdf, Ray& scattered, ShadowRay& shadow)
+    {
+        const MaterialEntry& material = scene.materials[hit.material];
+        if (material.flags & MaterialFlag_Emissive) {
+            Vec3 emitted = material.material->visit_emitted(hit.u, hit.v, hit.p);
+            if (scatter_pdf > 0 && hit.light >= 0) {
+                emitted = emitted * power_heuristic(scatter_pdf, scene.lights.pdf(ray, hit));
+            }
+            color += throughput * emitted;
+        }
+        Vec3 attenuation;
+        if (!material.material->visit_scatter(ray, hit, attenuation, scattered, sampler)) {
+            return false;
+        }
         
-        return emission_color + scatter_color;
+        scatter_pdf = 0;
+        if (sample_lights && !(material.flags & MaterialFlag_Specular)) {
+            sample_light(ray, hit, *material.material, scene, sampler, throughput, shadow);
+            scatter_pdf = material.material->visit_pdf(ray, hit, scattered.dir());
+        }
+        throughput = throughput * attenuation;
+        return true;
+    }
+    
+    // Light arriving at hit from a point sampled on a light, times the throughput, f * cos and the MIS weight
+    void sample_light(const Ray& ray, const Hit& hit, Material& material, const Scene& scene, Sampler& sampler,
+                      const Vec3& throughput, ShadowRay& shadow)
+    {
+        const double pick = sampler.get_1d();
+        double s1, s2;
+        sampler.get_2d(s1, s2);
+        LightSample light;
+        if (!scene.lights.sample(pick, s1, s2, hit.p, ray.time(), light)) {
+            return;
+        }
+        double scatter_pdf;
+        const Vec3 f = material.visit_eval(ray, hit, light.dir, scatter_pdf);
+        if (luminance(f * light.emission) <= 0) {
+            return;
+        }
+        const double weight = power_heuristic(light.pdf, scatter_pdf);
+        shadow.traced = true;
+        shadow.dir = light.dir;
+        shadow.distance = light.distance;
+        shadow.radiance = throughput * (f * light.emission * (weight / light.pdf));
+    }
+    
+    bool occluded(const Scene& scene, const Camera& camera, const Vec3& p, double time, const ShadowRay& shadow) {
+        // stops short of the light, which would occlude itself
+        const Interval shadow_limits(camera.ray_hit_min, shadow.distance * (1 - 1e-4));
+        return scene.occluded(Ray(p, shadow.dir, time), shadow_limits);
+    }
+    
+    // Russian roulette from camera.roulette_min_bounces on, false when the path ends
+    bool roulette(Vec3& throughput, int bounce, const Camera& camera, Sampler& sampler) {
+        if (bounce < camera.roulette_min_bounces) {
+            return true;
+        }
+        double max_throughput = std::max(throughput.X(), std::max(throughput.Y(), throughput.Z()));
+        double survive = std::min(max_throughput / camera.roulette_threshold, 1.0);
+        if (survive < 1 && sampler.get_1d() >= survive) {
+            return false;
+        }
+        throughput = throughput / survive;
+        return true;
+    }
+    
+    // MIS weight of a sample taken with pdf a, when the other strategy would have taken it with pdf b
+    static double power_heuristic(double a, double b) {
+        return a * a / (a * a + b * b);
+    }
+    
+    #if PATH_DEPTH_STATS
+    std::unique_ptr<std::atomic_uint64_t[]> path_depths;
+    
+    void print_path_depths(int max_bounces) {
+        uint64_t paths = 0, bounces = 0;
+        for (int d = 0; d <= max_bounces; d++) {
+            paths += path_depths[d];
+            bounces += d * path_depths[d];
+        }
+        std::cout << "path depths, mean " << bounces / (double) paths << std::endl;
+        for (int d = 1; d <= max_bounces; d++) {
+            std::cout << d << ": " << path_depths[d] << " (" << 100.0 * path_depths[d] / paths << "%)" << std::endl;
+        }
     }
+    #endif
     
     // needs #include <fstream>
     void test(const Scene& scene, Camera& camera) {
@@ -167,7 +555,8 @@ public:
         
         for (int k = 0; k < 1; k++) {
             Vec3 viewport_point;
-            Ray ray = camera.make_ray(camera.screen_W / 2, camera.screen_H / 2, viewport_point);
+            Sampler sampler(SamplerType_Independent, 1, thread_rng());
+            Ray ray = camera.make_ray(camera.screen_W / 2, camera.screen_H / 2, viewport_point, sampler);
             Hit hit;
             // auto color = ray_color(ray, max_bounces, scene);
             scene.hit(ray, Interval(camera.ray_hit_min, camera.ray_hit_max), hit);
@@ -14,7 +14,7 @@ public:
     ~Arena() {
         size = 0;
         current = 0;
-        delete memory;
+        delete[] memory;
         memory = nullptr;
     }
     
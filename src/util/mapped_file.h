@@ -0,0 +1,100 @@
+#ifndef mapped_file_h
+#define mapped_file_h
+
+#include <cstddef>
+#if defined _WIN64
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Read only memory mapping of a whole file, the pages are loaded on first access.
+// Empty files are not mapped, data() is nullptr then.
+class MappedFile {
+public:
+    MappedFile() { }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile() {
+        close();
+    }
+
+    bool open(const char* path) {
+        close();
+    #if defined _WIN64
+        file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                           FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE) return false;
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size)) {
+            close();
+            return false;
+        }
+        _size = (size_t) file_size.QuadPart;
+        if (_size == 0) return true;
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping == nullptr) {
+            close();
+            return false;
+        }
+        _data = (const char*) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    #else
+        fd = ::open(path, O_RDONLY);
+        if (fd < 0) return false;
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            close();
+            return false;
+        }
+        _size = (size_t) st.st_size;
+        if (_size == 0) return true;
+        void* p = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (p == MAP_FAILED) {
+            close();
+            return false;
+        }
+        _data = (const char*) p;
+        madvise(p, _size, MADV_SEQUENTIAL);
+    #endif
+        if (_data == nullptr) {
+            close();
+            return false;
+        }
+        return true;
+    }
+
+    void close() {
+    #if defined _WIN64
+        if (_data) UnmapViewOfFile(_data);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = nullptr;
+        file = INVALID_HANDLE_VALUE;
+    #else
+        if (_data) munmap((void*) _data, _size);
+        if (fd >= 0) ::close(fd);
+        fd = -1;
+    #endif
+        _data = nullptr;
+        _size = 0;
+    }
+
+    const char* data() const { return _data; }
+    size_t size() const { return _size; }
+
+private:
+    const char* _data = nullptr;
+    size_t _size = 0;
+#if defined _WIN64
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+#endif /* mapped_file_h */
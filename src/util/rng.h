@@ -0,0 +1,112 @@
+#ifndef rng_h
+#define rng_h
+
+#include <cstdint>
+#include <cmath>
+#include <atomic>
+
+// Counter based generator: the n-th number of a stream is a hash of the stream key and n,
+// the splitmix64 finalizer (Steele, Lea, Flood) over key + n * golden gamma.
+// A few cycles per number and 16 bytes of state, each render worker owns one.
+//
+// The tracer keys a stream per camera sample (pixel, sample index) and restarts the counter
+// at every bounce, so a number only depends on (pixel, sample, bounce, dimension).
+// Renders are then bitwise identical for any thread count, tile size or schedule,
+// and a rejection loop in one bounce doesn't shift the numbers of the next.
+class Rng {
+public:
+    Rng() : Rng(0) { }
+    explicit Rng(uint64_t seed) { this->seed(seed); }
+
+    // A plain sequential stream, any seed works, including 0
+    void seed(uint64_t seed) {
+        key = mix(seed);
+        counter = 0;
+        has_spare_normal = false;
+    }
+
+    // Stream of one camera sample, starts at bounce 0 (the camera ray)
+    void seed_sample(uint32_t pixel, uint32_t sample) {
+        key = mix(((uint64_t) sample << 32) | pixel);
+        start_bounce(0);
+    }
+
+    // Dimension 0 of a bounce, 2^32 dimensions per bounce
+    void start_bounce(uint32_t bounce) {
+        counter = (uint64_t) bounce << 32;
+        has_spare_normal = false;
+    }
+
+    // Stream key and counter, resume continues from them
+    uint64_t stream_key() const {
+        return key;
+    }
+
+    uint64_t position() const {
+        return counter;
+    }
+
+    // Continues a stream, for paths that are traced interleaved
+    void resume(uint64_t key, uint64_t position) {
+        this->key = key;
+        counter = position;
+        has_spare_normal = false;
+    }
+
+    uint64_t next() {
+        return mix(key + ++counter * 0x9e3779b97f4a7c15ull);
+    }
+
+    // [0,1)
+    double uniform() {
+        return (next() >> 11) * 0x1.0p-53;
+    }
+
+    // [min,max)
+    double uniform(double min, double max) {
+        return min + (max - min) * uniform();
+    }
+
+    // Standard normal, Marsaglia's polar method, every other call returns the cached second value
+    double normal() {
+        if (has_spare_normal) {
+            has_spare_normal = false;
+            return spare_normal;
+        }
+        double x, y, r2;
+        do {
+            x = uniform(-1, 1);
+            y = uniform(-1, 1);
+            r2 = x * x + y * y;
+        } while (r2 >= 1 || r2 == 0);
+        const double f = std::sqrt(-2 * std::log(r2) / r2);
+        spare_normal = y * f;
+        has_spare_normal = true;
+        return x * f;
+    }
+
+    // 64 bit hash, also seeds the sample patterns
+    static uint64_t mix(uint64_t z) {
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+        return z ^ (z >> 31);
+    }
+
+private:
+    uint64_t key;
+    uint64_t counter;
+    double spare_normal = 0;
+    bool has_spare_normal = false;
+};
+
+// The calling thread's generator, for code that has no Rng passed in
+// (scene setup, ConstantMedium inside hit). The tracer keys it for each camera sample,
+// the worker's Sampler draws from it too.
+// Threads get distinct seeds in the order they first use it, the first is the main thread building scenes.
+inline Rng& thread_rng() {
+    static std::atomic<uint64_t> thread_count { 0 };
+    static thread_local Rng rng(thread_count.fetch_add(1, std::memory_order_relaxed));
+    return rng;
+}
+
+#endif /* rng_h */
@@ -6,6 +6,7 @@
 #include <mutex>
 #include <queue>
 #include <functional>
+#include <latch>
 #if defined _WIN64
 #include <windows.h>
 #endif
@@ -4,6 +4,7 @@
 #include <limits>
 #include <filesystem>
 #include <cstdlib>
+#include "rng.h"
 
 const double infinity = std::numeric_limits<double>::infinity();
 const double pi = 3.14159265358979323846;
@@ -27,9 +28,9 @@ inline std::filesystem::path root_dir() {
     return path;
 }
 
-// [0,1)
+// [0,1), from the calling thread's generator
 inline double rw_random() {
-    return std::rand() / (RAND_MAX + 1.0);
+    return thread_rng().uniform();
 }
 
 // [min,max)
@@ -0,0 +1,194 @@
+#ifndef work_stealing_pool_h
+#define work_stealing_pool_h
+
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <deque>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include "thread_pool.h"
+
+// Each worker owns a deque of tasks. A worker takes tasks from the front of its own deque,
+// so the work queued on it progresses breadth first, and when it runs dry it steals from
+// the back of the other workers' deques. Tasks may enqueue more tasks (continuations),
+// which go to the back of the current worker's deque.
+// There is no barrier between tasks, wait() only blocks until everything is done.
+class WorkStealingPool {
+public:
+    WorkStealingPool(size_t num_threads, RWThreadPriority thread_priority) {
+        this->thread_priority = thread_priority;
+        this->_stop = false;
+        this->queued = 0;
+        this->pending = 0;
+        this->next_worker = 0;
+        for (size_t i = 0; i < num_threads; i++) {
+            workers.emplace_back(std::make_unique<Worker>());
+        }
+        this->setup();
+    }
+
+    ~WorkStealingPool() {
+        stop();
+        join();
+    }
+
+    size_t size() const {
+        return workers.size();
+    }
+
+    // Called from a worker thread, the task goes to that worker's deque,
+    // otherwise the workers are filled round robin
+    void enqueue(std::function<void()> task) {
+        size_t worker_index;
+        if (current_pool == this) {
+            worker_index = current_worker;
+        } else {
+            worker_index = next_worker.fetch_add(1, std::memory_order_relaxed) % workers.size();
+        }
+        enqueue(worker_index, std::move(task));
+    }
+
+    void enqueue(size_t worker_index, std::function<void()> task) {
+        pending++;
+        Worker& worker = *workers[worker_index % workers.size()];
+        {
+            std::unique_lock<std::mutex> lock(worker.mutex);
+            worker.tasks.emplace_back(std::move(task));
+        }
+        queued++;
+        {
+            // pairs with the predicate check in wait_for_work, avoids lost wake ups
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+        }
+        wake_condition.notify_one();
+    }
+
+    // Blocks until all enqueued tasks and the tasks they enqueued are done.
+    // Must not be called from a worker thread.
+    void wait() {
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        idle_condition.wait(lock, [this] {
+            return this->pending == 0;
+        });
+    }
+
+    // Runs fn(begin, end) over [0, count) in chunks of `grain` items and waits for all of them.
+    // Must not be called from a worker thread.
+    void parallel_for(size_t count, size_t grain, const std::function<void(size_t, size_t)>& fn) {
+        grain = std::max<size_t>(grain, 1);
+        for (size_t begin = 0; begin < count; begin += grain) {
+            size_t end = std::min(begin + grain, count);
+            enqueue([&fn, begin, end] { fn(begin, end); });
+        }
+        wait();
+    }
+
+    void stop() {
+        {
+            std::unique_lock<std::mutex> lock(sleep_mutex);
+            _stop = true;
+        }
+        wake_condition.notify_all();
+    }
+
+    void join() {
+        for (auto& thread: threads) {
+            if (thread.joinable())
+                thread.join();
+        }
+    }
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    RWThreadPriority thread_priority;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::atomic_size_t next_worker;
+    std::atomic_size_t queued;  // tasks sitting in deques
+    std::atomic_size_t pending; // queued + running
+    std::mutex sleep_mutex;
+    std::condition_variable wake_condition;
+    std::condition_variable idle_condition;
+    bool _stop;
+
+    static inline thread_local WorkStealingPool* current_pool = nullptr;
+    static inline thread_local size_t current_worker = 0;
+
+    void setup() {
+        for (size_t i = 0; i < workers.size(); i++) {
+            std::thread thread = std::thread( [this, i] {
+
+                #if defined __APPLE__
+                pthread_set_qos_class_self_np(qos_class(this->thread_priority), 0);
+                #endif
+
+                current_pool = this;
+                current_worker = i;
+
+                std::function<void()> task;
+                while (wait_for_work()) {
+                    if (!pop(i, task) && !steal(i, task)) {
+                        continue; // another worker was faster
+                    }
+                    task();
+                    task = nullptr;
+                    if (--pending == 0) {
+                        std::unique_lock<std::mutex> lock(sleep_mutex);
+                        idle_condition.notify_all();
+                    }
+                }
+            });
+
+            #if defined _WIN64
+            int prio = win_thread_priority(this->thread_priority);
+            HANDLE thread_handle = (HANDLE)thread.native_handle();
+            SetThreadPriority(thread_handle, prio);
+            #endif
+
+            threads.emplace_back(std::move(thread));
+        }
+    }
+
+    // false when the pool is stopping
+    bool wait_for_work() {
+        if (queued > 0) return true;
+        std::unique_lock<std::mutex> lock(sleep_mutex);
+        wake_condition.wait(lock, [this] {
+            return this->queued > 0 || this->_stop;
+        });
+        return !_stop;
+    }
+
+    bool pop(size_t worker_index, std::function<void()>& task) {
+        Worker& worker = *workers[worker_index];
+        std::unique_lock<std::mutex> lock(worker.mutex);
+        if (worker.tasks.empty()) return false;
+        task = std::move(worker.tasks.front());
+        worker.tasks.pop_front();
+        queued--;
+        return true;
+    }
+
+    bool steal(size_t thief_index, std::function<void()>& task) {
+        for (size_t k = 1; k < workers.size(); k++) {
+            Worker& victim = *workers[(thief_index + k) % workers.size()];
+            std::unique_lock<std::mutex> lock(victim.mutex);
+            if (victim.tasks.empty()) continue;
+            task = std::move(victim.tasks.back());
+            victim.tasks.pop_back();
+            queued--;
+            return true;
+        }
+        return false;
+    }
+};
+
+#endif /* work_stealing_pool_h */
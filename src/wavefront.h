@@ -0,0 +1,134 @@
+#ifndef wavefront_h
+#define wavefront_h
+
+#include <cstdint>
+#include <memory>
+#include <new>
+#include "util/arena.h"
+#include "geom/hittable.h"
+#include "material.h"
+#include "sampler.h"
+
+// How Tracer runs the paths of a tile pass
+// Megakernel - each path runs from the camera to its end in ray_color, then the next one starts
+// Wavefront - all paths of the pass advance one bounce at a time, a stage at a time (Laine, Karras, Aila 2013):
+//             intersect every ray, shade the hits grouped by material type, trace every shadow ray,
+//             then roulette. Each stage is a short loop over arrays of path state,
+//             its code and the data it touches stay in cache.
+// Both take the same random numbers for a path, renders are bitwise identical.
+typedef enum {
+    IntegratorType_Megakernel,
+    IntegratorType_Wavefront,
+} IntegratorType;
+
+const int material_type_count = MaterialType_Isotropic + 1;
+
+
+// State of the paths of one wavefront batch, one array per field (structure of arrays)
+// so a stage only streams through the fields it uses. Allocated once per worker from its arena.
+struct PathBatch {
+    size_t capacity = 0;
+    
+    // current ray
+    double *origin_x, *origin_y, *origin_z;
+    double *dir_x, *dir_y, *dir_z;
+    double *time;
+    // attenuation of the bounces so far and the light gathered
+    double *throughput_r, *throughput_g, *throughput_b;
+    double *color_r, *color_g, *color_b;
+    double *scatter_pdf; // of the current ray's direction, 0 when its light hits count in full
+    // camera sample (Image pixel index, sample index) and where its random numbers continue from
+    Sampler::Position* position;
+    Hit* hits;
+    uint8_t* scattered; // the path continues after this bounce's shading
+    
+    // Path indices: the paths still tracing in pixel order,
+    // the ones among them that hit something grouped by material type
+    uint32_t* active;
+    uint32_t* shading;
+    size_t active_count = 0;
+    size_t material_start[material_type_count + 1];
+    
+    // shadow rays of the bounce, from the path's hit point
+    uint32_t* shadow_path;
+    double *shadow_dir_x, *shadow_dir_y, *shadow_dir_z;
+    double *shadow_distance;
+    double *shadow_r, *shadow_g, *shadow_b; // added to the path's color when unoccluded
+    size_t shadow_count = 0;
+    
+    static size_t bytes(size_t capacity) {
+        const size_t arrays = 21 * sizeof(double) + 3 * sizeof(uint32_t)
+                            + sizeof(Sampler::Position) + sizeof(Hit) + sizeof(uint8_t);
+        // and the alignment padding of each of the 27 arrays
+        return capacity * arrays + 27 * 64;
+    }
+    
+    void allocate(Arena& arena, size_t capacity) {
+        this->capacity = capacity;
+        for (double** field: { &origin_x, &origin_y, &origin_z, &dir_x, &dir_y, &dir_z, &time,
+                               &throughput_r, &throughput_g, &throughput_b, &color_r, &color_g, &color_b, &scatter_pdf,
+                               &shadow_dir_x, &shadow_dir_y, &shadow_dir_z, &shadow_distance,
+                               &shadow_r, &shadow_g, &shadow_b }) {
+            *field = arena.allocate<double>(capacity);
+        }
+        for (uint32_t** field: { &active, &shading, &shadow_path }) {
+            *field = arena.allocate<uint32_t>(capacity);
+        }
+        position = arena.allocate<Sampler::Position>(capacity);
+        hits = arena.allocate<Hit>(capacity);
+        for (size_t i = 0; i < capacity; i++) {
+            new (&hits[i]) Hit();
+        }
+        scattered = arena.allocate<uint8_t>(capacity);
+    }
+    
+    Ray ray(uint32_t path) const {
+        return Ray(Vec3(origin_x[path], origin_y[path], origin_z[path]),
+                   Vec3(dir_x[path], dir_y[path], dir_z[path]), time[path]);
+    }
+    
+    void set_ray(uint32_t path, const Ray& ray) {
+        origin_x[path] = ray.origin().X();
+        origin_y[path] = ray.origin().Y();
+        origin_z[path] = ray.origin().Z();
+        dir_x[path] = ray.dir().X();
+        dir_y[path] = ray.dir().Y();
+        dir_z[path] = ray.dir().Z();
+        time[path] = ray.time();
+    }
+    
+    Vec3 throughput(uint32_t path) const {
+        return Vec3(throughput_r[path], throughput_g[path], throughput_b[path]);
+    }
+    
+    void set_throughput(uint32_t path, const Vec3& throughput) {
+        throughput_r[path] = throughput.X();
+        throughput_g[path] = throughput.Y();
+        throughput_b[path] = throughput.Z();
+    }
+    
+    Vec3 color(uint32_t path) const {
+        return Vec3(color_r[path], color_g[path], color_b[path]);
+    }
+    
+    void set_color(uint32_t path, const Vec3& color) {
+        color_r[path] = color.X();
+        color_g[path] = color.Y();
+        color_b[path] = color.Z();
+    }
+};
+
+
+// The calling worker's batch, with room for at least capacity paths.
+// Reallocated only when a larger one is asked for (a larger tile size).
+inline PathBatch& worker_path_batch(size_t capacity) {
+    static thread_local std::unique_ptr<Arena> arena;
+    static thread_local PathBatch batch;
+    if (batch.capacity < capacity) {
+        arena = std::make_unique<Arena>(PathBatch::bytes(capacity));
+        batch.allocate(*arena, capacity);
+    }
+    return batch;
+}
+
+#endif /* wavefront_h */